@@ -0,0 +1,69 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "CSE333.h"
+#include "Allocator.h"
+
+void Allocator_Init(Allocator *dst, const Allocator *src) {
+  Verify333(dst != NULL);
+
+  if (src == NULL) {
+    dst->alloc = NULL;
+    dst->free = NULL;
+    dst->ctx = NULL;
+    return;
+  }
+  Verify333(src->alloc != NULL);
+  Verify333(src->free != NULL);
+  *dst = *src;
+}
+
+void* Allocator_Alloc(const Allocator *allocator, size_t size) {
+  void *ptr;
+
+  if (allocator->alloc == NULL) {
+    ptr = malloc(size);
+  } else {
+    ptr = allocator->alloc(allocator->ctx, size);
+  }
+  Verify333(ptr != NULL);
+  return ptr;
+}
+
+void* Allocator_Calloc(const Allocator *allocator, size_t count, size_t size) {
+  void *ptr;
+
+  Verify333(size == 0 || count <= SIZE_MAX / size);
+  if (allocator->alloc == NULL) {
+    ptr = calloc(count, size);
+    Verify333(ptr != NULL);
+    return ptr;
+  }
+  ptr = Allocator_Alloc(allocator, count * size);
+  memset(ptr, 0, count * size);
+  return ptr;
+}
+
+void Allocator_Free(const Allocator *allocator, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return;
+  }
+  if (allocator->alloc == NULL) {
+    free(ptr);
+  } else {
+    allocator->free(allocator->ctx, ptr, size);
+  }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#ifndef HW1_ALLOCATOR_H_
+#define HW1_ALLOCATOR_H_
+
+#include <stddef.h>  // for size_t
+
+///////////////////////////////////////////////////////////////////////////////
+// An Allocator is a customer-supplied source of memory.
+//
+// LinkedList and HashTable normally get their memory from malloc and free.
+// A customer who wants these structures' memory to come from somewhere
+// else (a custom arena, a huge-page pool, a per-thread cache, ...) can pass
+// an Allocator when allocating the list or table, and every internal
+// allocation the structure makes is then done through it.  The list or
+// table keeps its own copy of the Allocator record, but ctx must stay
+// valid for as long as the structure does.
+
+// Allocates size bytes, suitably aligned for any type, on behalf of ctx.
+// Must not return NULL.
+typedef void* (*AllocFnPtr)(void *ctx, size_t size);
+
+// Returns memory that was obtained from the matching AllocFnPtr.  size is
+// the size that was asked for when the memory was allocated.
+typedef void (*FreeFnPtr)(void *ctx, void *ptr, size_t size);
+
+typedef struct {
+  AllocFnPtr  alloc;  // allocates memory
+  FreeFnPtr   free;   // frees memory from alloc
+  void       *ctx;    // passed to alloc and free
+} Allocator;
+
+// Wherever an Allocator is taken by pointer, NULL means malloc and free.
+
+// Helpers for the modules that keep an Allocator.  A kept Allocator whose
+// alloc is NULL stands for malloc and free.
+
+// Initialize dst as a copy of src, or as malloc and free if src is NULL.
+void Allocator_Init(Allocator *dst, const Allocator *src);
+
+// Allocate size bytes through allocator (never NULL).
+void* Allocator_Alloc(const Allocator *allocator, size_t size);
+
+// Allocate zeroed memory for count elements of size bytes each through
+// allocator (never NULL).  With malloc and free this is calloc, which can
+// hand large arrays straight from fresh zero pages.
+void* Allocator_Calloc(const Allocator *allocator, size_t count, size_t size);
+
+// Free size bytes at ptr through allocator.  ptr may be NULL.
+void Allocator_Free(const Allocator *allocator, void *ptr, size_t size);
+
+#endif  // HW1_ALLOCATOR_H_
@@ -0,0 +1,114 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "CSE333.h"
+#include "Arena.h"
+
+// Every allocation is aligned to this, which suits any type.
+#define ARENA_ALIGN 16
+
+// The chunk header is padded so that the memory after it stays aligned.
+#define ARENA_HEADER_SIZE \
+  ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+// Allocates a chunk with room for size bytes and links it into the arena.
+// If zero is true the chunk comes zero-filled.  Returns its first byte.
+static char* AddChunk(Arena *arena, size_t size, bool zero) {
+  ArenaChunk *chunk;
+
+  // calloc can hand big chunks straight from fresh (already zero) pages,
+  // so let it do the zeroing.
+  if (zero) {
+    chunk = (ArenaChunk *)
+        Allocator_Calloc(&arena->allocator, 1, ARENA_HEADER_SIZE + size);
+  } else {
+    chunk = (ArenaChunk *)
+        Allocator_Alloc(&arena->allocator, ARENA_HEADER_SIZE + size);
+  }
+  chunk->size = size;
+  chunk->next = arena->chunks;
+  arena->num_bytes += ARENA_HEADER_SIZE + size;
+  arena->chunks = chunk;
+  return (char *) chunk + ARENA_HEADER_SIZE;
+}
+
+// Allocates size bytes, zeroed if zero is true.
+static void* Allocate(Arena *arena, size_t size, bool zero) {
+  Verify333(arena != NULL);
+
+  size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+  // A request bigger than a quarter chunk gets a chunk of its own, rather
+  // than wasting the rest of the current one, which stays current.
+  if (size > arena->chunk_size / 4) {
+    return AddChunk(arena, size, zero);
+  }
+
+  if ((size_t) (arena->end - arena->next) < size) {
+    arena->next = AddChunk(arena, arena->chunk_size, false);
+    arena->end = arena->next + arena->chunk_size;
+  }
+  void *memory = arena->next;
+  arena->next += size;
+  if (zero) {
+    memset(memory, 0, size);
+  }
+  return memory;
+}
+
+// Sets up an empty arena, leaving its allocator alone.
+static void Reset(Arena *arena, size_t chunk_size) {
+  Verify333(chunk_size > 0);
+
+  arena->chunk_size = chunk_size;
+  arena->chunks = NULL;
+  arena->next = NULL;
+  arena->end = NULL;
+  arena->num_bytes = 0;
+}
+
+void Arena_Init(Arena *arena, size_t chunk_size, const Allocator *allocator) {
+  Verify333(arena != NULL);
+  Allocator_Init(&arena->allocator, allocator);
+  Reset(arena, chunk_size);
+}
+
+void Arena_Release(Arena *arena) {
+  Verify333(arena != NULL);
+
+  ArenaChunk *chunk = arena->chunks;
+  while (chunk != NULL) {
+    ArenaChunk *next = chunk->next;
+    Allocator_Free(&arena->allocator, chunk, ARENA_HEADER_SIZE + chunk->size);
+    chunk = next;
+  }
+  Reset(arena, arena->chunk_size);
+}
+
+void* Arena_Alloc(Arena *arena, size_t size) {
+  return Allocate(arena, size, false);
+}
+
+void* Arena_Calloc(Arena *arena, size_t count, size_t size) {
+  Verify333(size == 0 || count <= SIZE_MAX / size);
+  return Allocate(arena, count * size, true);
+}
+
+size_t Arena_NumBytes(const Arena *arena) {
+  Verify333(arena != NULL);
+  return arena->num_bytes;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#ifndef HW1_ARENA_H_
+#define HW1_ARENA_H_
+
+#include <stddef.h>  // for size_t
+
+#include "./Allocator.h"  // for Allocator
+
+///////////////////////////////////////////////////////////////////////////////
+// An Arena is a region allocator.
+//
+// Allocations are bump-allocated out of large chunks and are never freed
+// individually; instead Arena_Release frees every chunk, and so everything
+// ever allocated from the arena, at once.  That makes tearing down a data
+// structure that lives in an arena cost one free per chunk rather than
+// one per object.
+//
+// Like Slab, the Arena structure is defined here so that it can be
+// embedded in its owner.  Its fields are private to Arena.c.
+
+// A chunk of arena memory.  Allocations follow the header in memory.
+typedef struct arena_chunk {
+  struct arena_chunk *next;  // the next (older) chunk, or NULL
+  size_t              size;  // # of bytes after the header
+} ArenaChunk;
+
+typedef struct arena {
+  size_t      chunk_size;  // # of bytes in an ordinary chunk
+  ArenaChunk *chunks;      // every chunk, newest first
+  char       *next;        // next free byte in the current chunk
+  char       *end;         // end of the current chunk
+  size_t      num_bytes;   // total size of chunks, headers included
+  Allocator   allocator;   // where chunks come from
+} Arena;
+
+// Set up an empty arena.  No memory is allocated until the first
+// Arena_Alloc.
+//
+// Arguments:
+// - arena: the arena to initialize.
+// - chunk_size: the number of bytes to allocate from the system at a time
+//   (> 0).  Requests too big to share a chunk get one of their own.
+// - allocator: where to allocate chunks from, or NULL for malloc and free.
+void Arena_Init(Arena *arena, size_t chunk_size, const Allocator *allocator);
+
+// Free everything allocated from an arena.  The arena is left empty and
+// may be reused.
+//
+// Arguments:
+// - arena: the arena to release.
+void Arena_Release(Arena *arena);
+
+// Allocate memory from an arena.  It stays valid until the arena is
+// released.
+//
+// Arguments:
+// - arena: the arena to allocate from.
+// - size: the number of bytes to allocate.
+//
+// Returns:
+// - uninitialized memory, aligned for any type (never NULL).
+void* Arena_Alloc(Arena *arena, size_t size);
+
+// Allocate zero-filled memory for an array of count elements of size bytes
+// each from an arena.
+//
+// Arguments:
+// - arena: the arena to allocate from.
+// - count: the number of elements.
+// - size: the size of each element.
+//
+// Returns:
+// - zeroed memory, aligned for any type (never NULL).
+void* Arena_Calloc(Arena *arena, size_t count, size_t size);
+
+// Return the number of bytes an arena holds in chunks, however much of
+// them has been handed out.  This is O(1).
+//
+// Arguments:
+// - arena: the arena to query.
+size_t Arena_NumBytes(const Arena *arena);
+
+#endif  // HW1_ARENA_H_
@@ -9,44 +9,374 @@
  * author.
  */
 
+// for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
 
 #include "CSE333.h"
 #include "HashTable.h"
-#include "LinkedList.h"
 #include "HashTable_priv.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Internal helper functions.
 //
-#define INVALID_IDX -1
 
 // Grows the hashtable (ie, increase the number of buckets) if its load
 // factor has become too high.
 static void MaybeResize(HashTable *ht);
 
-// Finds the node within the provided list that contains the key k. The list
-// must be non-null. Returns an iterator whose node field points at the node
-// containing the key, or at NULL if the key was not found. It is up to the
-// client to free the iterator.
-static LLIterator* LinkedList_FindKey(LinkedList *list, HTKey_t k);
+// Shrinks the hashtable if removals have taken its load factor below the
+// table's min_load_factor.
+static void MaybeShrink(HashTable *ht);
+
+// Shrinks the hashtable, as MaybeShrink does, if its load factor is below
+// min_load (which, if 0, it never is).
+static void ShrinkIfBelow(HashTable *ht, double min_load);
+
+// Returns the number of buckets a right-sized table of ht's elements gets.
+static int CompactBucketCount(HashTable *ht);
+
+// The load factor a right-sized table is given: 1, or half the maximum if
+// that is lower, so a compacted table always has room to grow into.
+static double CompactLoadFactor(double max_load_factor) {
+  return max_load_factor < 2.0 ? max_load_factor / 2 : 1.0;
+}
+
+// Moves every element into a new array of num_buckets buckets by relinking
+// the existing nodes.  If incremental is true the move is spread across
+// subsequent operations; see MigrateStep.
+static void Rehash(HashTable *ht, int num_buckets, bool incremental);
+
+// Finds the node within the chain starting at *link that contains the key k.
+// Returns the link (either the bucket head or some node's next field) that
+// points at that node, or the chain's terminating NULL link if the key was
+// not found.  Either way the caller can insert or unlink at the returned
+// link without walking the chain again.
+static HTNode** ChainFindKey(HashTable *ht, HTNode **link, HTKey_t k);
+
+// Maps a key to a bucket number within an array of num_buckets buckets,
+// using ht's index mode.
+static int KeyToBucket(HashTable *ht, HTKey_t key, int num_buckets) {
+  __extension__ typedef unsigned __int128 uint128_t;
+
+  switch (ht->index_mode) {
+    case HT_INDEX_MASK:
+      return HashKeyMix(key) & (num_buckets - 1);
+    case HT_INDEX_FASTRANGE:
+      return ((uint128_t) HashKeyMix(key) * (uint64_t) num_buckets) >> 64;
+    default:
+      return key % num_buckets;
+  }
+}
 
 int HashKeyToBucketNum(HashTable *ht, HTKey_t key) {
-  return key % ht->num_buckets;
+  return KeyToBucket(ht, key, ht->num_buckets);
+}
+
+// Returns the number of buckets to actually use when asked for num_buckets:
+// the next power of two in HT_INDEX_MASK mode, and num_buckets otherwise.
+static int BucketCountFor(HashTable *ht, int num_buckets) {
+  int n = 1;
+
+  if (ht->index_mode != HT_INDEX_MASK) {
+    return num_buckets;
+  }
+  while (n < num_buckets) {
+    n *= 2;
+  }
+  return n;
+}
+
+// Occupancy bitmaps: bit i of a bitmap for num_buckets buckets lives in
+// word i / 64.
+#define BITMAP_WORDS(num_buckets) (((num_buckets) + 63) / 64)
+
+static inline void BitSet(uint64_t *bitmap, int i) {
+  bitmap[i / 64] |= 1ULL << (i % 64);
+}
+
+static inline void BitClear(uint64_t *bitmap, int i) {
+  bitmap[i / 64] &= ~(1ULL << (i % 64));
+}
+
+// Returns the index of the first set bit at or after start in a bitmap of
+// num_bits bits, or INVALID_IDX if there is none.  Skips 64 empty buckets
+// per word.
+static int BitNext(const uint64_t *bitmap, int num_bits, int start) {
+  if (start >= num_bits) {
+    return INVALID_IDX;
+  }
+
+  int w = start / 64;
+  uint64_t word = bitmap[w] & (~0ULL << (start % 64));
+  while (word == 0) {
+    if (++w >= BITMAP_WORDS(num_bits)) {
+      return INVALID_IDX;
+    }
+    word = bitmap[w];
+  }
+  return w * 64 + __builtin_ctzll(word);
+}
+
+// A reference to one bucket: its chain head, and the bitmap and index of
+// its occupancy bit.
+typedef struct {
+  HTNode  **head;
+  uint64_t *occupied;
+  int       idx;
+} BucketRef;
+
+// Returns the bucket that holds key, or that key should be inserted into.
+// While a migration is in progress that may be in either bucket array.
+static BucketRef BucketForKey(HashTable *ht, HTKey_t key) {
+  BucketRef ref;
+
+  if (ht->old_buckets != NULL) {
+    int old_bucket = KeyToBucket(ht, key, ht->old_num_buckets);
+    if (old_bucket >= ht->migrate_idx) {
+      ref.idx = old_bucket;
+      ref.head = &ht->old_buckets[old_bucket];
+      ref.occupied = ht->old_occupied;
+      return ref;
+    }
+  }
+  ref.idx = HashKeyToBucketNum(ht, key);
+  ref.head = &ht->buckets[ref.idx];
+  ref.occupied = ht->occupied;
+  return ref;
+}
+
+// Allocates an array of num_buckets empty buckets.  An empty bucket is just
+// a NULL head, so we let calloc zero the array: large arrays come straight
+// from fresh zero pages, and buckets that are never used are never touched.
+static HTNode** AllocateBuckets(HashTable *ht, int num_buckets) {
+  return (HTNode **)
+      Allocator_Calloc(&ht->allocator, num_buckets, sizeof(HTNode *));
+}
+
+// Allocates an all-clear occupancy bitmap for num_buckets buckets.
+static uint64_t* AllocateBitmap(HashTable *ht, int num_buckets) {
+  return (uint64_t *) Allocator_Calloc(&ht->allocator,
+                                       BITMAP_WORDS(num_buckets),
+                                       sizeof(uint64_t));
+}
+
+// Frees a bucket array and its occupancy bitmap, for num_buckets buckets,
+// from AllocateBuckets and AllocateBitmap.  Both may be NULL.
+static void FreeBuckets(HashTable *ht, HTNode **buckets, uint64_t *occupied,
+                        int num_buckets) {
+  Allocator_Free(&ht->allocator, buckets, num_buckets * sizeof(HTNode *));
+  Allocator_Free(&ht->allocator, occupied,
+                 BITMAP_WORDS(num_buckets) * sizeof(uint64_t));
+}
+
+// Allocates a node for ht from its slab.
+static inline HTNode* AllocateNode(HashTable *ht) {
+  return (HTNode *) Slab_Alloc(&ht->node_slab);
+}
+
+// Frees a node allocated by AllocateNode.
+static inline void FreeNode(HashTable *ht, HTNode *node) {
+  Slab_Free(&ht->node_slab, node);
 }
 
-// Frees the payload associated with a linked list node.
-static void HTKeyValuePtrFree(LLPayload_t payload) {
-  free(payload);
+// Calls value_free_function on the value of every node in an array of
+// num_buckets buckets.  Only the buckets marked in the occupancy bitmap
+// are visited.  The nodes themselves are left for the table's slab to
+// release.
+static void FreeChainValues(HTNode **buckets, const uint64_t *occupied,
+                            int num_buckets,
+                            ValueFreeFnPtr value_free_function) {
+  for (int i = BitNext(occupied, num_buckets, 0);
+       i != INVALID_IDX;
+       i = BitNext(occupied, num_buckets, i + 1)) {
+    for (HTNode *node = buckets[i]; node != NULL; node = node->next) {
+      value_free_function(node->kv.value);
+    }
+  }
+}
+
+// Unlinks and frees every node satisfying predicate from the chains of one
+// of ht's bucket arrays, keeping its occupancy bitmap up to date.  Returns
+// the number of nodes removed.
+static int RemoveChainsIf(HashTable *ht, HTNode **buckets,
+                          uint64_t *occupied, int num_buckets,
+                          HTPredicateFnPtr predicate, void *ctx,
+                          ValueFreeFnPtr value_free_function) {
+  int num_removed = 0;
+
+  for (int i = BitNext(occupied, num_buckets, 0);
+       i != INVALID_IDX;
+       i = BitNext(occupied, num_buckets, i + 1)) {
+    HTNode **link = &buckets[i];
+
+    while (*link != NULL) {
+      HTNode *node = *link;
+      if (!predicate(node->kv, ctx)) {
+        link = &node->next;
+        continue;
+      }
+      *link = node->next;
+      if (value_free_function != NULL) {
+        value_free_function(node->kv.value);
+      }
+      FreeNode(ht, node);
+      num_removed++;
+    }
+    if (buckets[i] == NULL) {
+      BitClear(occupied, i);
+    }
+  }
+  return num_removed;
 }
 
-// Deallocation functions that do nothing.  Useful if we want to deallocate
-// the structure (eg, the linked list) without deallocating its elements or
-// if we know that the structure is empty.
-static void LLNoOpFree(LLPayload_t freeme) { }
-static void HTNoOpFree(HTValue_t freeme) { }
+// Moves the chains of up to max_buckets old buckets into the current bucket
+// array, relinking each node onto the head of its new chain.  Ends the
+// migration once every old bucket has been moved.
+static void MigrateBuckets(HashTable *ht, int max_buckets) {
+  if (ht->old_buckets == NULL) {
+    return;
+  }
+
+  while (max_buckets-- > 0 && ht->migrate_idx < ht->old_num_buckets) {
+    HTNode *node = ht->old_buckets[ht->migrate_idx];
+    ht->old_buckets[ht->migrate_idx] = NULL;
+    BitClear(ht->old_occupied, ht->migrate_idx);
+    ht->migrate_idx++;
+
+    while (node != NULL) {
+      HTNode *next = node->next;
+      int bucket = HashKeyToBucketNum(ht, node->kv.key);
+      node->next = ht->buckets[bucket];
+      ht->buckets[bucket] = node;
+      BitSet(ht->occupied, bucket);
+      node = next;
+    }
+  }
+
+  if (ht->migrate_idx == ht->old_num_buckets) {
+    FreeBuckets(ht, ht->old_buckets, ht->old_occupied, ht->old_num_buckets);
+    ht->old_buckets = NULL;
+    ht->old_occupied = NULL;
+    ht->old_num_buckets = 0;
+    ht->migrate_idx = 0;
+  }
+}
+
+// Does the bounded share of migration work owed by num_ops operations.
+// Live iterators depend on the bucket layout, so lookups (which leave
+// iterators valid) hold off while there are any.  Insertions and removals
+// invalidate iterators anyway, so they always do their share; that way a
+// leaked or long-lived iterator can't keep the old buckets around.
+static void MigrateStep(HashTable *ht, int num_ops, bool is_lookup) {
+  if (ht->old_buckets != NULL && (!is_lookup || ht->iterators == NULL)) {
+    MigrateBuckets(ht, num_ops * HT_MIGRATE_BUCKETS);
+  }
+}
+
+// The two prefetch stages of HashTable_FindBatch and HashTable_InsertBatch,
+// which run them HT_BATCH_WINDOW and HT_BATCH_WINDOW / 2 keys ahead of the
+// key being resolved.  window is a ring of the bucket refs in flight, and i
+// the index within the batch of the key being prefetched.
+//
+// The first stage hashes key and prefetches its bucket, keeping the ref in
+// the window.  For the flat engine, it prefetches key's first probe group
+// instead.
+static void PrefetchBucket(HashTable *ht, BucketRef *window, int i,
+                           HTKey_t key) {
+  if (ht->engine == HT_ENGINE_FLAT) {
+    HTFlat_Prefetch(ht, key);
+    return;
+  }
+  window[i & (HT_BATCH_WINDOW - 1)] = BucketForKey(ht, key);
+  __builtin_prefetch(window[i & (HT_BATCH_WINDOW - 1)].head);
+}
+
+// The second stage prefetches the head node of the chain whose bucket the
+// first stage fetched.  The flat engine has no second stage.
+static void PrefetchChain(HashTable *ht, BucketRef *window, int i) {
+  if (ht->engine != HT_ENGINE_FLAT) {
+    __builtin_prefetch(*window[i & (HT_BATCH_WINDOW - 1)].head);
+  }
+}
+
+// Starts the pipeline at key start of a batch: runs the first stage on the
+// next HT_BATCH_WINDOW keys, and the second on the next half of those.
+// key_stride is the distance in bytes from one key to the next, so keys
+// can point into an array of HTKeyValue_t as well as of HTKey_t.
+static void PrimeWindow(HashTable *ht, BucketRef *window, const HTKey_t *keys,
+                        size_t key_stride, int start, int n) {
+  for (int i = start; i < n && i < start + HT_BATCH_WINDOW; i++) {
+    PrefetchBucket(ht, window, i,
+                   *(const HTKey_t *) ((const char *) keys + i * key_stride));
+  }
+  for (int i = start; i < n && i < start + HT_BATCH_WINDOW / 2; i++) {
+    PrefetchChain(ht, window, i);
+  }
+}
+
+// HTIterators walk the old buckets of a migration in progress (if any)
+// followed by the current buckets, as if they were one array.  These map
+// an iterator's bucket_idx onto that sequence.
+static BucketRef IterBucket(HashTable *ht, int idx) {
+  BucketRef ref;
+
+  if (idx < ht->old_num_buckets) {
+    ref.idx = idx;
+    ref.head = &ht->old_buckets[idx];
+    ref.occupied = ht->old_occupied;
+  } else {
+    ref.idx = idx - ht->old_num_buckets;
+    ref.head = &ht->buckets[ref.idx];
+    ref.occupied = ht->occupied;
+  }
+  return ref;
+}
+
+// Returns the first non-empty bucket at or after start in the iteration
+// sequence, or INVALID_IDX if there is none.
+static int IterNextBucket(HashTable *ht, int start) {
+  int idx;
+
+  if (start < ht->old_num_buckets) {
+    idx = BitNext(ht->old_occupied, ht->old_num_buckets, start);
+    if (idx != INVALID_IDX) {
+      return idx;
+    }
+    start = ht->old_num_buckets;
+  }
+  idx = BitNext(ht->occupied, ht->num_buckets, start - ht->old_num_buckets);
+  return idx == INVALID_IDX ? INVALID_IDX : idx + ht->old_num_buckets;
+}
+
+// Moves a chained iterator to the head of the first non-empty bucket at or
+// after start, or marks it invalid if there is none.  Returns whether the
+// iterator is still valid.
+static bool IterSeekBucket(HTIterator *iter, int start) {
+  iter->bucket_idx = IterNextBucket(iter->ht, start);
+  if (iter->bucket_idx == INVALID_IDX) {
+    iter->link = NULL;
+    return false;
+  }
+  iter->link = IterBucket(iter->ht, iter->bucket_idx).head;
+  return true;
+}
+
+uint64_t HashKeyMix(HTKey_t key) {
+  // The "fmix64" finalizer from MurmurHash3.
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -72,56 +402,237 @@ HTKey_t FNVHash64(unsigned char *buffer, int len) {
   return hval;
 }
 
+void HTOptions_Init(HTOptions *options) {
+  Verify333(options != NULL);
+  options->engine = HT_ENGINE_CHAINED;
+  options->incremental_resize = false;
+  options->index_mode = HT_INDEX_MODULO;
+  options->max_load_factor = 3.0;
+  options->growth_factor = 9.0;
+  options->min_load_factor = 0.0;
+  options->arena = false;
+  options->allocator = NULL;
+}
+
 HashTable* HashTable_Allocate(int num_buckets) {
+  return HashTable_AllocateWithOptions(num_buckets, NULL);
+}
+
+HashTable* HashTable_AllocateWithOptions(int num_buckets,
+                                         const HTOptions *options) {
   HashTable *ht;
-  int i;
+  HTOptions defaults;
 
   Verify333(num_buckets > 0);
-
-  // Allocate the hash table record.
-  ht = (HashTable *) malloc(sizeof(HashTable));
-  Verify333(ht != NULL);
+  if (options == NULL) {
+    HTOptions_Init(&defaults);
+    options = &defaults;
+  }
+  Verify333(options->max_load_factor > 0.0);
+  Verify333(options->growth_factor > 1.0);
+  Verify333(options->min_load_factor >= 0.0);
+  Verify333(options->min_load_factor <
+            options->max_load_factor / options->growth_factor);
+  Verify333(options->min_load_factor <
+            CompactLoadFactor(options->max_load_factor));
+
+  // Allocate the hash table record.  Everything else the table allocates
+  // goes through the copy of the allocator it keeps.
+  Allocator allocator;
+  Allocator_Init(&allocator, options->allocator);
+  ht = (HashTable *) Allocator_Alloc(&allocator, sizeof(HashTable));
 
   // Initialize the record.
-  ht->num_buckets = num_buckets;
+  ht->allocator = allocator;
   ht->num_elements = 0;
-  ht->buckets = (LinkedList **) malloc(num_buckets * sizeof(LinkedList *));
-  Verify333(ht->buckets != NULL);
-  for (i = 0; i < num_buckets; i++) {
-    ht->buckets[i] = LinkedList_Allocate();
+  ht->engine = options->engine;
+  ht->index_mode = options->index_mode;
+  ht->iterators = NULL;
+  ht->max_load_factor = options->max_load_factor;
+  ht->growth_factor = options->growth_factor;
+  ht->min_load_factor = options->min_load_factor;
+  ht->incremental = options->incremental_resize;
+  ht->old_buckets = NULL;
+  ht->old_occupied = NULL;
+  ht->old_num_buckets = 0;
+  ht->migrate_idx = 0;
+  ht->use_arena = options->arena;
+  if (ht->use_arena) {
+    Arena_Init(&ht->arena, HT_ARENA_CHUNK_SIZE, options->allocator);
+    Slab_InitInArena(&ht->node_slab, sizeof(HTNode), &ht->arena);
+  } else {
+    Slab_Init(&ht->node_slab, sizeof(HTNode), options->allocator);
+  }
+  ht->num_deleted = 0;
+  ht->ctrl = NULL;
+  ht->keys = NULL;
+  ht->values = NULL;
+  memset(&ht->stats, 0, sizeof(HTStats));
+  ht->trace = NULL;
+  ht->trace_value_size = NULL;
+  HashTable_LatencyReset(ht);
+
+  if (ht->engine == HT_ENGINE_FLAT) {
+    ht->buckets = NULL;
+    ht->occupied = NULL;
+    HTFlat_Init(ht, num_buckets);
+    return ht;
   }
 
+  ht->num_buckets = BucketCountFor(ht, num_buckets);
+  ht->buckets = AllocateBuckets(ht, ht->num_buckets);
+  ht->occupied = AllocateBitmap(ht, ht->num_buckets);
+
   return ht;
 }
 
 void HashTable_Free(HashTable *table,
                     ValueFreeFnPtr value_free_function) {
-  int i;
+  Allocator allocator;
 
   Verify333(table != NULL);
+  HT_TRACE(table, HT_TRACE_FREE, 0, NULL);
+  HashTable_StopTrace(table);
+
+  // Detach any iterators still live, so they can be freed later.
+  for (HTIterator *iter = table->iterators; iter != NULL; iter = iter->next) {
+    iter->ht = NULL;
+  }
 
-  // Free each bucket's chain.
-  for (i = 0; i < table->num_buckets; i++) {
-    LinkedList *bucket = table->buckets[i];
-    HTKeyValue_t *kv;
-
-    // Pop elements off the chain list one at a time.  We can't do a single
-    // call to LinkedList_Free since we need to use the passed-in
-    // value_free_function -- which takes a HTValue_t, not an LLPayload_t -- to
-    // free the caller's memory.
-    while (LinkedList_NumElements(bucket) > 0) {
-      Verify333(LinkedList_Pop(bucket, (LLPayload_t *)&kv));
-      value_free_function(kv->value);
-      free(kv);
+  if (table->engine == HT_ENGINE_FLAT) {
+    HTFlat_Free(table, value_free_function);
+    allocator = table->allocator;
+    Allocator_Free(&allocator, table, sizeof(HashTable));
+    return;
+  }
+
+  // Walk each bucket's chain, handing each value to the caller's
+  // value_free_function on the way.  A migration may still have chains
+  // in the old bucket array, too.  With no value_free_function there's
+  // nothing to do per element, so skip the walk entirely.
+  if (value_free_function != NULL) {
+    FreeChainValues(table->buckets, table->occupied, table->num_buckets,
+                    value_free_function);
+    if (table->old_buckets != NULL) {
+      FreeChainValues(table->old_buckets, table->old_occupied,
+                      table->old_num_buckets, value_free_function);
     }
-    // The chain is empty, so we can pass in the
-    // null free function to LinkedList_Free.
-    LinkedList_Free(bucket, LLNoOpFree);
+  }
+  FreeBuckets(table, table->old_buckets, table->old_occupied,
+              table->old_num_buckets);
+
+  // Free the nodes and the bucket array within the table, then free the
+  // table record itself.
+  Slab_Release(&table->node_slab);
+  if (table->use_arena) {
+    Arena_Release(&table->arena);
+  }
+  FreeBuckets(table, table->buckets, table->occupied, table->num_buckets);
+  allocator = table->allocator;
+  Allocator_Free(&allocator, table, sizeof(HashTable));
+}
+
+void HashTable_Compact(HashTable *table) {
+  Verify333(table != NULL);
+  HT_TRACE(table, HT_TRACE_COMPACT, 0, NULL);
+
+  if (table->engine == HT_ENGINE_FLAT) {
+    HTFlat_Compact(table);
+    return;
   }
 
-  // Free the bucket array within the table, then free the table record itself.
-  free(table->buckets);
-  free(table);
+  // Finish any migration in progress even if the size is already right,
+  // so that the table is left as compact as it gets.
+  int num_buckets = CompactBucketCount(table);
+  if (num_buckets != table->num_buckets) {
+    Rehash(table, num_buckets, false);
+  } else {
+    MigrateBuckets(table, table->old_num_buckets);
+  }
+}
+
+void HashTable_Reserve(HashTable *table, int num_elements) {
+  Verify333(table != NULL);
+  Verify333(num_elements >= 0);
+  HT_TRACE(table, HT_TRACE_RESERVE, num_elements, NULL);
+
+  if (table->engine == HT_ENGINE_FLAT) {
+    HTFlat_Reserve(table, num_elements);
+    return;
+  }
+
+  // Grow to the smallest bucket count that keeps num_elements under the
+  // maximum load; inserts check the load before adding, so this is
+  // enough for the last of them not to resize.
+  int num_buckets =
+      BucketCountFor(table, (int) (num_elements / table->max_load_factor) + 1);
+  if (num_buckets > table->num_buckets) {
+    Rehash(table, num_buckets, false);
+  }
+
+  // Make sure the slab has the nodes for the elements still to come, in
+  // one contiguous block.
+  if (num_elements > table->num_elements) {
+    Slab_Reserve(&table->node_slab, num_elements - table->num_elements);
+  }
+}
+
+HashTable* HashTable_BuildFromArray(const HTKeyValue_t *keyvalues,
+                                   int n,
+                                   HTDupPolicy_t dup_policy,
+                                   const HTOptions *options) {
+  HashTable *ht;
+
+  Verify333(n >= 0);
+  ht = HashTable_AllocateWithOptions(1, options);
+  HashTable_Reserve(ht, n);
+
+  for (int i = 0; i < n; i++) {
+    HTKeyValue_t kv = keyvalues[i];
+
+    if (ht->engine == HT_ENGINE_FLAT) {
+      if (dup_policy == HT_DUP_UNIQUE) {
+        HTFlat_InsertUnique(ht, kv);
+        HT_STAT_INC(ht, inserts);
+      } else {
+        bool inserted;
+        HTValue_t *value = HTFlat_FindOrInsert(ht, kv.key, &inserted);
+        if (inserted) {
+          *value = kv.value;
+          HT_STAT_INC(ht, inserts);
+        } else if (dup_policy == HT_DUP_REPLACE) {
+          *value = kv.value;
+          HT_STAT_INC(ht, replacements);
+        }
+      }
+      continue;
+    }
+
+    // The table is already big enough, so skip the resize checks of the
+    // regular insert path and go straight to the chain.  Unique keys don't
+    // need the chain searched at all: push them onto its head.
+    BucketRef bucket = BucketForKey(ht, kv.key);
+    HTNode **link = bucket.head;
+    if (dup_policy != HT_DUP_UNIQUE) {
+      link = ChainFindKey(ht, bucket.head, kv.key);
+      if (*link != NULL) {
+        if (dup_policy == HT_DUP_REPLACE) {
+          (*link)->kv = kv;
+          HT_STAT_INC(ht, replacements);
+        }
+        continue;
+      }
+    }
+
+    HTNode *node = AllocateNode(ht);
+    node->kv = kv;
+    node->next = *link;
+    *link = node;
+    BitSet(bucket.occupied, bucket.idx);
+    ht->num_elements++;
+    HT_STAT_INC(ht, inserts);
+  }
+  return ht;
 }
 
 int HashTable_NumElements(HashTable *table) {
@@ -129,143 +640,532 @@ int HashTable_NumElements(HashTable *table) {
   return table->num_elements;
 }
 
-bool HashTable_Insert(HashTable *table,
-                      HTKeyValue_t newkeyvalue,
-                      HTKeyValue_t *oldkeyvalue) {
-  int bucket;
-  LinkedList *chain;
+HTMemoryUsage HashTable_MemoryUsage(HashTable *table) {
+  HTMemoryUsage usage;
+  size_t storage_bytes;
 
   Verify333(table != NULL);
-  MaybeResize(table);
 
-  // Calculate which bucket and chain we're inserting into.
-  bucket = HashKeyToBucketNum(table, newkeyvalue.key);
-  chain = table->buckets[bucket];
+  // The index is sized by the bucket counts alone, and the slab (or its
+  // arena) keeps a running total of the node storage it holds.
+  usage.entry_bytes = (size_t) table->num_elements * sizeof(HTKeyValue_t);
+  if (table->engine == HT_ENGINE_FLAT) {
+    usage.index_bytes = (size_t) table->num_buckets * sizeof(uint8_t);
+    storage_bytes = (size_t) table->num_buckets *
+                    (sizeof(HTKey_t) + sizeof(HTValue_t));
+  } else {
+    usage.index_bytes =
+        (size_t) table->num_buckets * sizeof(HTNode *) +
+        BITMAP_WORDS(table->num_buckets) * sizeof(uint64_t) +
+        (size_t) table->old_num_buckets * sizeof(HTNode *) +
+        BITMAP_WORDS(table->old_num_buckets) * sizeof(uint64_t);
+    storage_bytes = table->use_arena ? Arena_NumBytes(&table->arena) :
+                                       Slab_NumBytes(&table->node_slab);
+  }
+  usage.index_bytes += sizeof(HashTable);
+  usage.node_bytes = storage_bytes - usage.entry_bytes;
+  usage.total_bytes = usage.index_bytes + usage.node_bytes + usage.entry_bytes;
+  return usage;
+}
 
-  // STEP 1: finish the implementation of InsertHashTable.
-  // This is a fairly complex task, so you might decide you want
-  // to define/implement a helper function that helps you find
-  // and optionally remove a key within a chain, rather than putting
-  // all that logic inside here.  You might also find that your helper
-  // can be reused in steps 2 and 3.
+// Adds the lengths of the chains in buckets to stats' shape fields.
+static void AddChainLengths(HTNode **buckets, int num_buckets,
+                            HTStats *stats) {
+  for (int i = 0; i < num_buckets; i++) {
+    int len = 0;
+    for (HTNode *node = buckets[i]; node != NULL; node = node->next) {
+      len++;
+    }
+    stats->chain_histogram[len < HT_STATS_CHAIN_BINS ?
+                           len : HT_STATS_CHAIN_BINS - 1]++;
+    if (len > stats->max_chain) {
+      stats->max_chain = len;
+    }
+  }
+}
 
-  // Get an iterator that points to the node containing the matching key.
-  LLIterator *lli = LinkedList_FindKey(chain, newkeyvalue.key);
+HTStats HashTable_GetStats(HashTable *table) {
+  Verify333(table != NULL);
 
-  // If the iterator looped through completely without finding key,
-  // add the new key value pair to the end of the current chain.
-  if (!LLIterator_IsValid(lli)) {
-    // Allocate space for the payload (a key value pointer).
-    HTKeyValue_t *kv_ptr = (HTKeyValue_t*) malloc(sizeof(HTKeyValue_t));
-    Verify333(kv_ptr != NULL);
+  HTStats stats = table->stats;
+  stats.finds = stats.hits + stats.misses;
+  stats.load_factor = (double) table->num_elements / table->num_buckets;
+  if (table->engine == HT_ENGINE_FLAT) {
+    return stats;
+  }
 
-    // Initialize the key value pair.
-    *kv_ptr = newkeyvalue;
+  // Both bucket arrays hold chains while a migration is in progress.  The
+  // old buckets already migrated count as empty ones.
+  AddChainLengths(table->buckets, table->num_buckets, &stats);
+  if (table->old_buckets != NULL) {
+    AddChainLengths(table->old_buckets, table->old_num_buckets, &stats);
+  }
+  uint64_t num_chains = table->num_buckets + table->old_num_buckets -
+                        stats.chain_histogram[0];
+  if (num_chains > 0) {
+    stats.mean_chain = (double) table->num_elements / num_chains;
+  }
+  return stats;
+}
 
-    // Append the key value pair.
-    LinkedList_Append(chain, kv_ptr);
+uint64_t HTClock(void) {
+#if !defined(HT_DISABLE_STATS) || defined(HT_ENABLE_LATENCY)
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+bool HashTable_LatencySnapshot(HashTable *table, HTLatencyOp_t op,
+                               HTLatencyHistogram *histogram) {
+  Verify333(table != NULL);
+  Verify333(op >= 0 && op < HT_LATENCY_NUM_OPS);
+  Verify333(histogram != NULL);
+
+#ifdef HT_ENABLE_LATENCY
+  *histogram = table->latency[op];
+  return true;
+#else
+  memset(histogram, 0, sizeof(HTLatencyHistogram));
+  return false;
+#endif
+}
+
+void HashTable_LatencyReset(HashTable *table) {
+  Verify333(table != NULL);
+#ifdef HT_ENABLE_LATENCY
+  memset(table->latency, 0, sizeof(table->latency));
+#endif
+}
 
-    // Free the iterator.
-    LLIterator_Free(lli);
+// Returns the latency bucket ns falls in.  Below 8ns every nanosecond has
+// its own bucket; above, each power of two [2^e, 2^(e+1)) is split into 8
+// buckets by the 3 bits after the leading one.
+static int LatencyBucket(uint64_t ns) {
+  if (ns < 8) {
+    return (int) ns;
+  }
+  int e = 63 - __builtin_clzll(ns);
+  return (e - 2) * 8 + (int) ((ns >> (e - 3)) & 7);
+}
+
+// Returns the largest latency that falls in bucket.
+static uint64_t LatencyBucketMax(int bucket) {
+  if (bucket < 8) {
+    return bucket;
+  }
+  int e = bucket / 8 + 2;
+  uint64_t first = (uint64_t) (8 + bucket % 8) << (e - 3);
+  return first + ((UINT64_C(1) << (e - 3)) - 1);
+}
+
+void HTLatency_Record(HTLatencyHistogram *histogram, uint64_t ns) {
+  Verify333(histogram != NULL);
+  histogram->count++;
+  histogram->total_ns += ns;
+  if (ns > histogram->max_ns) {
+    histogram->max_ns = ns;
+  }
+  histogram->buckets[LatencyBucket(ns)]++;
+}
+
+void HTLatency_Merge(HTLatencyHistogram *dst, const HTLatencyHistogram *src) {
+  Verify333(dst != NULL);
+  Verify333(src != NULL);
+  dst->count += src->count;
+  dst->total_ns += src->total_ns;
+  if (src->max_ns > dst->max_ns) {
+    dst->max_ns = src->max_ns;
+  }
+  for (int i = 0; i < HT_LATENCY_BUCKETS; i++) {
+    dst->buckets[i] += src->buckets[i];
+  }
+}
+
+uint64_t HTLatency_Percentile(const HTLatencyHistogram *histogram,
+                              double percentile) {
+  Verify333(histogram != NULL);
+  Verify333(percentile >= 0.0 && percentile <= 100.0);
+
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  // The latency of this rank (counting from 1) is the one we want.
+  uint64_t rank = (uint64_t) (percentile / 100.0 * histogram->count + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < HT_LATENCY_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      uint64_t ns = LatencyBucketMax(i);
+      return ns < histogram->max_ns ? ns : histogram->max_ns;
+    }
+  }
+  return histogram->max_ns;
+}
+
+// Returns the node holding key in the chain of bucket, first adding one
+// (with a NULL value) if key isn't present yet.  *inserted says which
+// happened.  The caller has done any migration or resize the insert calls
+// for, and found key's bucket after that.
+static HTNode *ChainFindOrInsertAt(HashTable *table, BucketRef bucket,
+                                   HTKey_t key, bool *inserted) {
+  // Get the link that points to the node containing the matching key,
+  // within the chain we're inserting into.
+  HTNode **link = ChainFindKey(table, bucket.head, key);
+
+  // If the chain was walked completely without finding key, the link is
+  // the chain's terminating NULL; hang the new node there.
+  *inserted = (*link == NULL);
+  if (*inserted) {
+    HTNode *node = AllocateNode(table);
+    node->kv.key = key;
+    node->kv.value = NULL;
+    node->next = NULL;
+    if (link == bucket.head) {
+      BitSet(bucket.occupied, bucket.idx);
+    }
+    *link = node;
 
     // Update the table's size.
     table->num_elements++;
+  }
+  return *link;
+}
 
-    // Indicate that this was a new key.
-    return false;
+// ChainFindOrInsertAt, doing the migration and resize and finding the
+// bucket itself.
+static HTNode *ChainFindOrInsert(HashTable *table, HTKey_t key,
+                                 bool *inserted) {
+  MigrateStep(table, 1, false);
+  MaybeResize(table);
+  return ChainFindOrInsertAt(table, BucketForKey(table, key), key, inserted);
+}
+
+// Whether a chained insert would neither migrate nor resize, so that a
+// bucket found now stays right for it.
+static bool InsertInPlace(HashTable *table) {
+  return table->engine != HT_ENGINE_FLAT && table->old_buckets == NULL &&
+      table->num_elements < table->max_load_factor * table->num_buckets;
+}
+
+// HashTable_Insert.  If bucket isn't NULL, it's newkeyvalue's bucket,
+// found while InsertInPlace(table) held, and the insert goes straight into
+// it.
+static bool InsertKey(HashTable *table,
+                      const BucketRef *bucket,
+                      HTKeyValue_t newkeyvalue,
+                      HTKeyValue_t *oldkeyvalue) {
+  HTNode *node;
+  bool inserted;
+  uint64_t start = HT_LATENCY_CLOCK();
+
+  Verify333(table != NULL);
+  HT_TRACE(table, HT_TRACE_INSERT, newkeyvalue.key, newkeyvalue.value);
+  if (table->engine == HT_ENGINE_FLAT) {
+    inserted = !HTFlat_Insert(table, newkeyvalue, oldkeyvalue);
+  } else {
+    // If the key was already present, use the return param to store the
+    // key value pair that will be replaced, then replace the pair with the
+    // new pair.
+    if (bucket != NULL) {
+      node = ChainFindOrInsertAt(table, *bucket, newkeyvalue.key, &inserted);
+    } else {
+      node = ChainFindOrInsert(table, newkeyvalue.key, &inserted);
+    }
+    if (!inserted) {
+      *oldkeyvalue = node->kv;
+    }
+    node->kv = newkeyvalue;
+  }
+  if (inserted) {
+    HT_STAT_INC(table, inserts);
+  } else {
+    HT_STAT_INC(table, replacements);
+  }
+  HT_LATENCY_RECORD(table, HT_LATENCY_INSERT, start);
+
+  // Indicate whether a pair was replaced.
+  return !inserted;
+}
+
+bool HashTable_Insert(HashTable *table,
+                      HTKeyValue_t newkeyvalue,
+                      HTKeyValue_t *oldkeyvalue) {
+  return InsertKey(table, NULL, newkeyvalue, oldkeyvalue);
+}
+
+void HashTable_FindOrInsert(HashTable *table,
+                            HTKey_t key,
+                            HTValue_t **slot,
+                            bool *inserted) {
+  uint64_t start = HT_LATENCY_CLOCK();
+
+  Verify333(table != NULL);
+  HT_TRACE(table, HT_TRACE_FIND_OR_INSERT, key, NULL);
+  if (table->engine == HT_ENGINE_FLAT) {
+    *slot = HTFlat_FindOrInsert(table, key, inserted);
+  } else {
+    *slot = &ChainFindOrInsert(table, key, inserted)->kv.value;
+  }
+  if (*inserted) {
+    HT_STAT_INC(table, misses);
+    HT_STAT_INC(table, inserts);
+  } else {
+    HT_STAT_INC(table, hits);
   }
+  HT_LATENCY_RECORD(table, HT_LATENCY_INSERT, start);
+}
 
-  // Otherwise, the iterator now points at the node with the matching key.
-  // Store the key value pair pointer in curr (the node payload).
-  HTKeyValue_t *curr;
-  LLIterator_Get(lli, (LLPayload_t*) &curr);
+// HashTable_Find, less the latency recording.
+static bool FindKey(HashTable *table, HTKey_t key, HTKeyValue_t *keyvalue) {
+  Verify333(table != NULL);
+  HT_TRACE(table, HT_TRACE_FIND, key, NULL);
+  if (table->engine == HT_ENGINE_FLAT) {
+    bool found = HTFlat_Find(table, key, keyvalue);
+    HT_STAT_ADD(table, hits, found);
+    HT_STAT_ADD(table, misses, !found);
+    return found;
+  }
+
+  HTNode *node;
 
-  // Use the return param to store the key value pair that will be replaced,
-  // then replace the pair with the new pair.
-  *oldkeyvalue = *curr;
-  *curr = newkeyvalue;
+  // Find the node within the key's chain.
+  MigrateStep(table, 1, true);
+  node = *ChainFindKey(table, BucketForKey(table, key).head, key);
 
-  // Free the iterator.
-  LLIterator_Free(lli);
+  // If the node is NULL, then the key was not found.
+  if (node == NULL) {
+    HT_STAT_INC(table, misses);
+    return false;
+  }
 
-  // A pair was replaced.
+  // Return the pair through the return parameter.
+  HT_STAT_INC(table, hits);
+  *keyvalue = node->kv;
   return true;
 }
 
 bool HashTable_Find(HashTable *table,
                     HTKey_t key,
                     HTKeyValue_t *keyvalue) {
-  Verify333(table != NULL);
+  uint64_t start = HT_LATENCY_CLOCK();
+  bool found = FindKey(table, key, keyvalue);
+  HT_LATENCY_RECORD(table, HT_LATENCY_FIND, start);
+  return found;
+}
 
-  int bucket;
-  LinkedList *chain;
+// HashTable_Remove, less the latency recording.
+static bool RemoveKey(HashTable *table, HTKey_t key, HTKeyValue_t *keyvalue) {
+  Verify333(table != NULL);
+  HT_TRACE(table, HT_TRACE_REMOVE, key, NULL);
+  if (table->engine == HT_ENGINE_FLAT) {
+    bool removed = HTFlat_Remove(table, key, keyvalue);
+    HT_STAT_ADD(table, removes, removed);
+    return removed;
+  }
 
-  // Calculate which bucket and chain we're inserting into.
-  bucket = HashKeyToBucketNum(table, key);
-  chain = table->buckets[bucket];
+  BucketRef bucket;
+  HTNode **link;
+  HTNode *node;
 
-  // STEP 2: implement HashTable_Find.
-  // Get an iterator stopped at the correct key.
-  LLIterator *lli = LinkedList_FindKey(chain, key);
+  // Get the link that points to the node containing the matching key,
+  // within the chain we're removing from.
+  MigrateStep(table, 1, false);
+  bucket = BucketForKey(table, key);
+  link = ChainFindKey(table, bucket.head, key);
+  node = *link;
 
-  // If the iterator is not valid, then the key was not found.
-  if (!LLIterator_IsValid(lli)) {
-    // Free the iterator.
-    LLIterator_Free(lli);
+  // If the node is NULL, then the key was not found.
+  if (node == NULL) {
     return false;
   }
 
-  // Store the key value pair pointer in curr, then use it to return the
-  // pair through the return parameter.
-  HTKeyValue_t *curr;
-  LLIterator_Get(lli, (LLPayload_t*) &curr);
-  *keyvalue = *curr;
+  // Return the pair through the return parameter, then unlink and free
+  // the node.
+  *keyvalue = node->kv;
+  *link = node->next;
+  FreeNode(table, node);
+  if (*bucket.head == NULL) {
+    BitClear(bucket.occupied, bucket.idx);
+  }
 
-  // Free the iterator.
-  LLIterator_Free(lli);
+  // Update the hash table size.
+  table->num_elements--;
+  HT_STAT_INC(table, removes);
 
-  // Indicate that the pair was found.
+  MaybeShrink(table);
   return true;
 }
 
 bool HashTable_Remove(HashTable *table,
                       HTKey_t key,
                       HTKeyValue_t *keyvalue) {
-  Verify333(table != NULL);
+  uint64_t start = HT_LATENCY_CLOCK();
+  bool removed = RemoveKey(table, key, keyvalue);
+  HT_LATENCY_RECORD(table, HT_LATENCY_REMOVE, start);
+  return removed;
+}
 
-  // STEP 3: implement HashTable_Remove.
-  int bucket;
-  LinkedList *chain;
 
-  // Calculate which bucket and chain we're inserting into.
-  bucket = HashKeyToBucketNum(table, key);
-  chain = table->buckets[bucket];
+int HashTable_RemoveIf(HashTable *table,
+                       HTPredicateFnPtr predicate,
+                       void *ctx,
+                       ValueFreeFnPtr value_free_function,
+                       bool shrink) {
+  int num_removed = 0;
 
-  // Get an iterator that points to the node containing the matching key.
-  LLIterator *lli = LinkedList_FindKey(chain, key);
+  Verify333(table != NULL);
+  Verify333(predicate != NULL);
+
+  if (table->engine == HT_ENGINE_FLAT) {
+    for (int slot = HTFlat_NextFull(table, 0);
+         slot != INVALID_IDX;
+         slot = HTFlat_NextFull(table, slot + 1)) {
+      HTKeyValue_t kv = { table->keys[slot], table->values[slot] };
+      if (predicate(kv, ctx)) {
+        HTFlat_RemoveSlot(table, slot);
+        if (value_free_function != NULL) {
+          value_free_function(kv.value);
+        }
+        num_removed++;
+      }
+    }
+    HT_STAT_ADD(table, removes, num_removed);
+    if (shrink) {
+      HTFlat_Shrink(table);
+    }
+    return num_removed;
+  }
 
-  // If the iterator is not valid, then the key was not found.
-  if (!LLIterator_IsValid(lli)) {
-    // Free the iterator.
-    LLIterator_Free(lli);
-    return false;
+  // Sweep both bucket arrays if a migration is in progress.  The old
+  // buckets that have already been migrated are empty, so the bitmap skips
+  // them.
+  if (table->old_buckets != NULL) {
+    num_removed += RemoveChainsIf(table, table->old_buckets,
+                                  table->old_occupied,
+                                  table->old_num_buckets, predicate, ctx,
+                                  value_free_function);
+  }
+  num_removed += RemoveChainsIf(table, table->buckets, table->occupied,
+                                table->num_buckets, predicate, ctx,
+                                value_free_function);
+  table->num_elements -= num_removed;
+  HT_STAT_ADD(table, removes, num_removed);
+
+  // Without a min_load_factor, a shrink asked for here kicks in at half
+  // the load growing leaves a table at, so that it can't undo a growth
+  // that hasn't been filled yet.
+  if (shrink && table->min_load_factor <= 0.0) {
+    ShrinkIfBelow(table,
+                  table->max_load_factor / table->growth_factor / 2);
+  } else {
+    MaybeShrink(table);
   }
+  return num_removed;
+}
 
-  // Return the pair through the return parameter.
-  HTKeyValue_t *curr;
-  LLIterator_Get(lli, (LLPayload_t*) &curr);
-  *keyvalue = *curr;
+int HashTable_FindBatch(HashTable *table,
+                        const HTKey_t *keys,
+                        int n,
+                        HTKeyValue_t *keyvalues,
+                        bool *found) {
+  BucketRef window[HT_BATCH_WINDOW];
+  int num_found = 0;
 
-  // Remove the current node from the chain.
-  LLIterator_Remove(lli, HTKeyValuePtrFree);
+  Verify333(table != NULL);
+  Verify333(n >= 0);
 
-  // Free the iterator.
-  LLIterator_Free(lli);
+  // Do the whole batch's share of migration work up front, so that the
+  // bucket layout holds still while the window runs ahead of the lookups.
+  if (table->engine != HT_ENGINE_FLAT) {
+    MigrateStep(table, n, true);
+  }
+  PrimeWindow(table, window, keys, sizeof(HTKey_t), 0, n);
+
+  for (int i = 0; i < n; i++) {
+    HT_TRACE(table, HT_TRACE_FIND, keys[i], NULL);
+
+    // By now key i's bucket and chain head should be in the cache (and
+    // ChainFindKey prefetches the rest of the chain as it goes).
+    if (table->engine == HT_ENGINE_FLAT) {
+      found[i] = HTFlat_Find(table, keys[i], &keyvalues[i]);
+    } else {
+      HTNode **head = window[i & (HT_BATCH_WINDOW - 1)].head;
+      HTNode *node = *ChainFindKey(table, head, keys[i]);
+      found[i] = (node != NULL);
+      if (node != NULL) {
+        keyvalues[i] = node->kv;
+      }
+    }
+    num_found += found[i];
 
-  // Update the hash table size.
-  table->num_elements--;
+    // Key i's slot in the window is free now; move the window along.
+    if (i + HT_BATCH_WINDOW < n) {
+      PrefetchBucket(table, window, i + HT_BATCH_WINDOW,
+                     keys[i + HT_BATCH_WINDOW]);
+    }
+    if (i + HT_BATCH_WINDOW / 2 < n) {
+      PrefetchChain(table, window, i + HT_BATCH_WINDOW / 2);
+    }
+  }
+  HT_STAT_ADD(table, hits, num_found);
+  HT_STAT_ADD(table, misses, n - num_found);
+  return num_found;
+}
 
-  return true;
+int HashTable_InsertBatch(HashTable *table,
+                          const HTKeyValue_t *newkeyvalues,
+                          int n,
+                          HTKeyValue_t *oldkeyvalues,
+                          bool *replaced) {
+  BucketRef window[HT_BATCH_WINDOW];
+  bool primed = false;
+  int num_replaced = 0;
+
+  Verify333(table != NULL);
+  Verify333(n >= 0);
+
+  for (int i = 0; i < n; i++) {
+    // Chained inserts go straight into the buckets the window found, as
+    // long as they won't migrate or resize the table.  One that will goes
+    // through the regular path, and leaves the window's buckets stale; it
+    // starts again once the table can take inserts in place.  (While a
+    // migration is in progress that's every insert, so the window sits
+    // idle rather than being refilled for each.)  The flat engine's
+    // prefetches can't go stale in any way that matters, so its window
+    // just keeps running.
+    bool in_place = InsertInPlace(table);
+    bool pipelined = in_place || table->engine == HT_ENGINE_FLAT;
+
+    if (pipelined && !primed) {
+      PrimeWindow(table, window, &newkeyvalues[0].key, sizeof(HTKeyValue_t),
+                  i, n);
+      primed = true;
+    }
+    if (in_place) {
+      replaced[i] = InsertKey(table, &window[i & (HT_BATCH_WINDOW - 1)],
+                              newkeyvalues[i], &oldkeyvalues[i]);
+    } else {
+      replaced[i] = InsertKey(table, NULL, newkeyvalues[i], &oldkeyvalues[i]);
+      primed = primed && table->engine == HT_ENGINE_FLAT;
+    }
+    num_replaced += replaced[i];
+
+    if (primed && i + HT_BATCH_WINDOW < n) {
+      PrefetchBucket(table, window, i + HT_BATCH_WINDOW,
+                     newkeyvalues[i + HT_BATCH_WINDOW].key);
+    }
+    if (primed && i + HT_BATCH_WINDOW / 2 < n) {
+      PrefetchChain(table, window, i + HT_BATCH_WINDOW / 2);
+    }
+  }
+  return num_replaced;
 }
 
 
@@ -274,18 +1174,26 @@ bool HashTable_Remove(HashTable *table,
 
 HTIterator* HTIterator_Allocate(HashTable *table) {
   HTIterator *iter;
-  int         i;
 
   Verify333(table != NULL);
 
-  iter = (HTIterator *) malloc(sizeof(HTIterator));
-  Verify333(iter != NULL);
+  // The iterator keeps its own copy of the allocator, so that it can be
+  // freed even after the table has been.
+  iter = (HTIterator *) Allocator_Alloc(&table->allocator, sizeof(HTIterator));
+  iter->allocator = table->allocator;
+  iter->prev = NULL;
+  iter->next = table->iterators;
+  if (table->iterators != NULL) {
+    table->iterators->prev = iter;
+  }
+  table->iterators = iter;
+  HT_TRACE(table, HT_TRACE_ITERATE, 0, NULL);
 
   // If the hash table is empty, the iterator is immediately invalid,
   // since it can't point to anything.
   if (table->num_elements == 0) {
     iter->ht = table;
-    iter->bucket_it = NULL;
+    iter->link = NULL;
     iter->bucket_idx = INVALID_IDX;
     return iter;
   }
@@ -293,24 +1201,33 @@ HTIterator* HTIterator_Allocate(HashTable *table) {
   // Initialize the iterator.  There is at least one element in the
   // table, so find the first element and point the iterator at it.
   iter->ht = table;
-  for (i = 0; i < table->num_buckets; i++) {
-    if (LinkedList_NumElements(table->buckets[i]) > 0) {
-      iter->bucket_idx = i;
-      break;
-    }
+  if (table->engine == HT_ENGINE_FLAT) {
+    iter->link = NULL;
+    iter->bucket_idx = HTFlat_NextFull(table, 0);
+    Verify333(iter->bucket_idx != INVALID_IDX);  // make sure we found it.
+    return iter;
   }
-  Verify333(i < table->num_buckets);  // make sure we found it.
-  iter->bucket_it = LLIterator_Allocate(table->buckets[iter->bucket_idx]);
+  Verify333(IterSeekBucket(iter, 0));  // make sure we found it.
   return iter;
 }
 
 void HTIterator_Free(HTIterator *iter) {
   Verify333(iter != NULL);
-  if (iter->bucket_it != NULL) {
-    LLIterator_Free(iter->bucket_it);
-    iter->bucket_it = NULL;
+
+  // Take the iterator off its table's list, unless the table has already
+  // been freed (and so detached it).
+  if (iter->ht != NULL) {
+    if (iter->prev != NULL) {
+      iter->prev->next = iter->next;
+    } else {
+      iter->ht->iterators = iter->next;
+    }
+    if (iter->next != NULL) {
+      iter->next->prev = iter->prev;
+    }
   }
-  free(iter);
+  Allocator allocator = iter->allocator;
+  Allocator_Free(&allocator, iter, sizeof(HTIterator));
 }
 
 bool HTIterator_IsValid(HTIterator *iter) {
@@ -328,28 +1245,22 @@ bool HTIterator_Next(HTIterator *iter) {
     return false;
   }
 
-  // Get the current list iterator, and attempt to advance it.
-  if (LLIterator_Next(iter->bucket_it)) {
-    return true;
+  // Flat tables step straight to the next full slot.
+  if (iter->ht->engine == HT_ENGINE_FLAT) {
+    iter->bucket_idx = HTFlat_NextFull(iter->ht, iter->bucket_idx + 1);
+    return iter->bucket_idx != INVALID_IDX;
   }
 
-  // The iterator must have moved past the end of the current bucket's list.
-  // At this point a new bucket with valid content has to be found by
-  // looping through the buckets array, starting with the next bucket.
-  while (++(iter->bucket_idx) < iter->ht->num_buckets) {
-    LinkedList *currList = iter->ht->buckets[iter->bucket_idx];
-    if (LinkedList_NumElements(currList) > 0) {
-      // A valid bucket was found. Update the iterator.
-      iter->bucket_it = LLIterator_Allocate(currList);
-      return true;
-    }
+  // Attempt to advance within the current bucket's chain.
+  iter->link = &(*iter->link)->next;
+  if (*iter->link != NULL) {
+    return true;
   }
 
-  // Indicate there were no elements after the bucket we advanced past,
-  // and mark the iterator as invalid.
-  iter->bucket_idx = INVALID_IDX;
-  iter->bucket_it = NULL;
-  return false;
+  // The iterator must have moved past the end of the current bucket's chain.
+  // At this point a new bucket with valid content has to be found; the
+  // occupancy bitmaps take us straight to the next one.
+  return IterSeekBucket(iter, iter->bucket_idx + 1);
 }
 
 bool HTIterator_Get(HTIterator *iter, HTKeyValue_t *keyvalue) {
@@ -362,95 +1273,155 @@ bool HTIterator_Get(HTIterator *iter, HTKeyValue_t *keyvalue) {
     return false;
   }
 
-  // Use the current iterator's linked list iterator to get the key value pair.
-  HTKeyValue_t *kv_ptr;
-  LLIterator_Get(iter->bucket_it, (LLPayload_t*) &kv_ptr);
-  *keyvalue = *kv_ptr;
+  if (iter->ht->engine == HT_ENGINE_FLAT) {
+    keyvalue->key = iter->ht->keys[iter->bucket_idx];
+    keyvalue->value = iter->ht->values[iter->bucket_idx];
+    return true;
+  }
+
+  // Copy the key value pair out of the node the iterator is at.
+  *keyvalue = (*iter->link)->kv;
   return true;
 }
 
 bool HTIterator_Remove(HTIterator *iter, HTKeyValue_t *keyvalue) {
-  HTKeyValue_t kv;
+  HashTable *ht;
 
   Verify333(iter != NULL);
 
   // Try to get what the iterator is pointing to.
-  if (!HTIterator_Get(iter, &kv)) {
+  if (!HTIterator_Get(iter, keyvalue)) {
     return false;
   }
+  ht = iter->ht;
+  HT_TRACE(ht, HT_TRACE_REMOVE, keyvalue->key, NULL);
+
+  // The iterator already knows exactly where the element lives, so remove
+  // it from there rather than looking its key up again.
+  if (ht->engine == HT_ENGINE_FLAT) {
+    HTFlat_RemoveSlot(ht, iter->bucket_idx);
+    HT_STAT_INC(ht, removes);
+    iter->bucket_idx = HTFlat_NextFull(ht, iter->bucket_idx + 1);
+    return true;
+  }
 
-  // Advance the iterator.  Thanks to the above call to
-  // HTIterator_Get, we know that this iterator is valid (though it
-  // may not be valid after this call to HTIterator_Next).
-  HTIterator_Next(iter);
-
-  // Lastly, remove the element.  Again, we know this call will succeed
-  // due to the successful HTIterator_Get above.
-  Verify333(HashTable_Remove(iter->ht, kv.key, keyvalue));
-  Verify333(kv.key == keyvalue->key);
-  Verify333(kv.value == keyvalue->value);
+  // Unlink and free the node; the link now points at its successor, which
+  // is where the iterator belongs.
+  HTNode *node = *iter->link;
+  *iter->link = node->next;
+  FreeNode(ht, node);
+  ht->num_elements--;
+  HT_STAT_INC(ht, removes);
+  if (*iter->link != NULL) {
+    return true;
+  }
 
+  // That was the end of the chain.  If it was the whole chain, the bucket
+  // is now empty; either way, move on to the next non-empty bucket.
+  BucketRef bucket = IterBucket(ht, iter->bucket_idx);
+  if (*bucket.head == NULL) {
+    BitClear(bucket.occupied, bucket.idx);
+  }
+  IterSeekBucket(iter, iter->bucket_idx + 1);
   return true;
 }
 
 static void MaybeResize(HashTable *ht) {
-  HashTable *newht;
-  HashTable tmp;
-  HTIterator *it;
-
-  // Resize if the load factor is > 3.
-  if (ht->num_elements < 3 * ht->num_buckets)
+  // Resize if the load factor has reached the maximum (3 by default).
+  if (ht->num_elements < ht->max_load_factor * ht->num_buckets)
     return;
 
-  // This is the resize case.  Allocate a new hashtable,
-  // iterate over the old hashtable, do the surgery on
-  // the old hashtable record and free up the new hashtable
-  // record.
-  newht = HashTable_Allocate(ht->num_buckets * 9);
-
-  // Loop through the old ht copying its elements over into the new one.
-  for (it = HTIterator_Allocate(ht);
-       HTIterator_IsValid(it);
-       HTIterator_Next(it)) {
-    HTKeyValue_t item, unused;
-
-    Verify333(HTIterator_Get(it, &item));
-    HashTable_Insert(newht, item, &unused);
+  // Multiply the number of buckets by the growth factor (9 by default).
+  // A small factor may not be enough to get back under the maximum load,
+  // in which case grow as far as that takes instead.
+  int64_t num_buckets = (int64_t) (ht->num_buckets * ht->growth_factor);
+  int64_t min_buckets = (int64_t) (ht->num_elements / ht->max_load_factor) + 1;
+  if (num_buckets < min_buckets) {
+    num_buckets = min_buckets;
   }
 
-  // Swap the new table onto the old, then free the old table (tricky!).  We
-  // use the "no-op free" because we don't actually want to free the elements;
-  // they're owned by the new table.
-  tmp = *ht;
-  *ht = *newht;
-  *newht = tmp;
+  // When bucket counts must stay powers of two, round down to one (so the
+  // default 9 becomes 8), but at least double and still get under the
+  // maximum load.
+  if (ht->index_mode == HT_INDEX_MASK) {
+    int64_t n = (int64_t) ht->num_buckets * 2;
+    while (n * 2 <= num_buckets || n < min_buckets) {
+      n *= 2;
+    }
+    num_buckets = n;
+  }
+  Verify333(num_buckets <= INT_MAX);
+  Rehash(ht, (int) num_buckets, ht->incremental);
+}
 
-  // Done!  Clean up our iterator and temporary table.
-  HTIterator_Free(it);
-  HashTable_Free(newht, &HTNoOpFree);
+static void MaybeShrink(HashTable *ht) {
+  ShrinkIfBelow(ht, ht->min_load_factor);
 }
 
-static LLIterator* LinkedList_FindKey(LinkedList *list, HTKey_t k) {
-  // Allocate the iterator pointing at the first node.
-  LLIterator *lli = LLIterator_Allocate(list);
+static void ShrinkIfBelow(HashTable *ht, double min_load) {
+  // Resize if the load factor is below the minimum.  Only removals get
+  // here, and they invalidate any live iterators anyway.
+  if (min_load <= 0.0 || ht->num_elements >= min_load * ht->num_buckets)
+    return;
 
-  // If the list is empty, return without attempting to find the key.
-  if (!LLIterator_IsValid(lli)) {
-    return lli;
+  // Right-size, which puts the load factor back between the minimum and
+  // the load that triggers growth.
+  int num_buckets = CompactBucketCount(ht);
+  if (num_buckets < ht->num_buckets) {
+    Rehash(ht, num_buckets, ht->incremental);
   }
+}
+
+static int CompactBucketCount(HashTable *ht) {
+  double load = CompactLoadFactor(ht->max_load_factor);
+  int num_buckets = (int) (ht->num_elements / load);
 
-  // The payload of each node is a pointer to a key value pair.
-  // Use get to replace curr with current node's payload.
-  HTKeyValue_t *curr;
-  LLIterator_Get(lli, (LLPayload_t*) &curr);
+  if (num_buckets < ht->num_elements / load) {
+    num_buckets++;
+  }
+  return BucketCountFor(ht, num_buckets > 0 ? num_buckets : 1);
+}
 
-  // Continue to loop until the current node's key is the desired key,
-  // or the iterator has fully iterated through the list.
-  while (curr->key != k && LLIterator_Next(lli)) {
-    LLIterator_Get(lli, (LLPayload_t*) &curr);
+static void Rehash(HashTable *ht, int num_buckets, bool incremental) {
+  uint64_t start = HTClock();
+
+  // Any migration still in flight has to finish before another can begin.
+  MigrateBuckets(ht, ht->old_num_buckets);
+
+  // Swap in the new bucket array, keeping the current one as the source
+  // of the migration.
+  ht->old_buckets = ht->buckets;
+  ht->old_occupied = ht->occupied;
+  ht->old_num_buckets = ht->num_buckets;
+  ht->migrate_idx = 0;
+  ht->num_buckets = BucketCountFor(ht, num_buckets);
+  ht->buckets = AllocateBuckets(ht, ht->num_buckets);
+  ht->occupied = AllocateBitmap(ht, ht->num_buckets);
+
+  // An incremental resize leaves the old buckets for MigrateStep to drain;
+  // otherwise move every node across right now.  Either way each node is
+  // relinked in place: nothing is allocated or copied per element, and
+  // since keys are already unique no chain is searched for duplicates.
+  if (!incremental) {
+    MigrateBuckets(ht, ht->old_num_buckets);
   }
+  HT_STAT_INC(ht, resizes);
+  HT_STAT_ADD(ht, resize_nanos, HTClock() - start);
+  HT_LATENCY_RECORD(ht, HT_LATENCY_RESIZE, start);
+}
 
-  // The iterator is now past the end, or points at the node with the
-  // correct key.
-  return lli;
+static HTNode** ChainFindKey(HashTable *ht, HTNode **link, HTKey_t k) {
+  // Follow the links until one points at the node with the desired key,
+  // or at the NULL that terminates the chain.
+  while (*link != NULL) {
+    // The next node's address is already in hand, so start fetching it
+    // while this node's key is compared.
+    __builtin_prefetch((*link)->next);
+    HT_STAT_INC(ht, keys_compared);
+    if ((*link)->kv.key == k) {
+      break;
+    }
+    link = &(*link)->next;
+  }
+  return link;
 }
@@ -14,6 +14,9 @@
 
 #include <stdbool.h>    // for bool type (true, false)
 #include <stdint.h>     // for uint64_t, etc.
+#include <stdio.h>      // for FILE
+
+#include "./Allocator.h"  // for Allocator
 
 ///////////////////////////////////////////////////////////////////////////////
 // A HashTable is a automatically-resizing chained hash table.
@@ -30,6 +33,7 @@
 // will start to grow.  This implementation will dynamically resize the
 // hashtable when the load factor exceeds 3.  It will multiple the number
 // of buckets in the hashtable by 9, so that post-resize load factor is 1/3.
+// Both numbers can be changed per table; see HTOptions.
 //
 // To hide the implementation of HashTable, we declare the "struct ht"
 // structure and its associated typedef here, but we *define* the structure
@@ -86,6 +90,114 @@ HTKey_t FNVHash64(unsigned char *buffer, int len);
 // Returns a pointer to the newly allocated HashTable.
 HashTable* HashTable_Allocate(int num_buckets);
 
+// A HashTable can be built on one of several storage engines.  Every
+// engine supports the full HashTable and HTIterator interface with the
+// same semantics; they differ only in memory layout and performance.
+//
+// - HT_ENGINE_CHAINED: the default.  An array of buckets, each holding
+//   a chain of (key,value) entries.
+// - HT_ENGINE_FLAT: open addressing.  Keys, values and a one-byte
+//   control tag per slot live in flat arrays, and lookups compare a
+//   whole group of 16 tags at once (with SSE2 where available).  This
+//   keeps a typical lookup to one or two cache lines.
+typedef enum {
+  HT_ENGINE_CHAINED,
+  HT_ENGINE_FLAT
+} HTEngine_t;
+
+// How a chained table maps a key to one of its buckets.
+//
+// - HT_INDEX_MODULO: the default.  key % num_buckets, on the raw key.
+// - HT_INDEX_MASK: bucket counts are kept to powers of two and the bucket
+//   is the low bits of the mixed key.  No divide; the mix makes sure
+//   structured keys (eg, multiples of a power of two) still spread evenly.
+// - HT_INDEX_FASTRANGE: Lemire's "fastrange" reduction of the mixed key,
+//   (mix(key) * num_buckets) >> 64.  No divide, and any bucket count works.
+typedef enum {
+  HT_INDEX_MODULO,
+  HT_INDEX_MASK,
+  HT_INDEX_FASTRANGE
+} HTIndexMode_t;
+
+// Options that customize a HashTable at allocation time.  Customers
+// should initialize an HTOptions with HTOptions_Init and then override
+// only the fields they care about, so that future fields pick up
+// sensible defaults.
+//
+// - incremental_resize: if true, a chained table that outgrows its
+//   buckets doesn't rebuild them all inside one HashTable_Insert.
+//   Instead it allocates the larger bucket array and keeps both live,
+//   and each subsequent insert, find and remove moves a bounded number
+//   of old buckets across.  This trades a little per-operation work for
+//   the removal of resize latency spikes.  Ignored by the flat engine.
+//
+// - index_mode: see HTIndexMode_t.  Ignored by the flat engine, which
+//   always masks the mixed key.
+//
+// - max_load_factor: a chained table grows once its load factor (elements
+//   per bucket) reaches this.  Lower values mean shorter chains and faster
+//   lookups at the cost of more buckets.  Must be greater than 0.
+//
+// - growth_factor: when a chained table grows, its bucket count is
+//   multiplied by this, or by more if that isn't enough to bring the load
+//   factor back under max_load_factor.  Must be greater than 1.  In
+//   HT_INDEX_MASK mode the new count is rounded down to a power of two
+//   (but is at least double the old one), so the default of 9 grows by 8
+//   there.
+//
+// - min_load_factor: if greater than 0, a chained table whose load factor
+//   drops below this after a removal shrinks back to the size that
+//   HashTable_Compact would pick.  Must be less than the load factor just
+//   after growing (max_load_factor / growth_factor) and than the load
+//   factor of a compacted table, so that growing and shrinking can't chase
+//   each other.
+//
+// The flat engine ignores all three load settings: it always grows at a
+// load of 7/8, by doubling.  Use HashTable_Compact to shrink it.
+//
+// - arena: if true, a chained table allocates its nodes from an arena of
+//   large (1MiB) chunks rather than from the heap one page at a time.
+//   Removed nodes are still reused, but their memory only goes back to the
+//   system when the table is freed, at the cost of one free per chunk.
+//   Best for tables that are built, used and then discarded whole.
+//   Ignored by the flat engine, whose entries already live in a few large
+//   arrays.
+//
+// - allocator: where the table gets its memory: every allocation it makes
+//   (its record, bucket arrays, nodes, arena chunks, flat arrays and
+//   iterators) is done through it.  NULL means malloc and free.  The table
+//   keeps a copy of the Allocator record, so only its ctx has to outlive
+//   the table.
+typedef struct {
+  HTEngine_t    engine;              // default HT_ENGINE_CHAINED
+  bool          incremental_resize;  // default false
+  HTIndexMode_t index_mode;          // default HT_INDEX_MODULO
+  double        max_load_factor;     // default 3
+  double        growth_factor;       // default 9
+  double        min_load_factor;     // default 0 (never shrink)
+  bool          arena;               // default false
+  const Allocator *allocator;        // default NULL (malloc and free)
+} HTOptions;
+
+// Initialize an HTOptions to the default configuration (the one used by
+// HashTable_Allocate).
+//
+// Arguments:
+// - options: the options record to initialize; must be non-NULL.
+void HTOptions_Init(HTOptions *options);
+
+// Allocate and return a new HashTable configured by options.
+//
+// Arguments:
+// - num_buckets: the number of buckets (for the flat engine, the number
+//   of slots) the hash table should initially contain; MUST be greater
+//   than zero.  Engines may round this up.
+// - options: the configuration to use; NULL means the defaults.
+//
+// Returns a pointer to the newly allocated HashTable.
+HashTable* HashTable_AllocateWithOptions(int num_buckets,
+                                         const HTOptions *options);
+
 // Free a HashTable and its entries.
 //
 // Arguments:
@@ -93,9 +205,72 @@ HashTable* HashTable_Allocate(int num_buckets);
 //   after this function returns.
 //
 // - value_free_function:  this argument is a pointer to a value
-//   freeing function; see above for details.
+//   freeing function; see above for details.  If the values need no
+//   freeing, pass NULL: the elements are then not visited at all, which
+//   for an arena-mode table (see HTOptions) makes freeing the table cost
+//   one free per arena chunk.
 void HashTable_Free(HashTable *table, ValueFreeFnPtr value_free_function);
 
+// What HashTable_BuildFromArray does when a key appears more than once
+// in its input.
+//
+// - HT_DUP_REPLACE: the last (key,value) for the key wins, exactly as if
+//   the pairs had been inserted in order with HashTable_Insert.
+// - HT_DUP_KEEP_FIRST: the first (key,value) for the key wins.
+// - HT_DUP_UNIQUE: the caller guarantees that every key is distinct, so
+//   no chain is searched for an existing key.  Duplicate keys give
+//   undefined results.
+//
+// With HT_DUP_REPLACE and HT_DUP_KEEP_FIRST, the values of the pairs that
+// lose are not freed; they remain the caller's responsibility.
+typedef enum {
+  HT_DUP_REPLACE,
+  HT_DUP_KEEP_FIRST,
+  HT_DUP_UNIQUE
+} HTDupPolicy_t;
+
+// Allocate and return a new HashTable holding the given (key,value)
+// pairs.  This is much faster than allocating a table and inserting the
+// pairs one by one: the table is sized once, up front, for n elements, so
+// it never resizes while being filled, and the pairs are placed in a
+// single pass.  A chained table also allocates all of its nodes in one
+// contiguous block.
+//
+// Arguments:
+// - keyvalues: an array of n (key,value) pairs to insert.
+// - n: the number of pairs (>= 0).
+// - dup_policy: how to treat repeated keys; see HTDupPolicy_t.
+// - options: the configuration to use; NULL means the defaults.
+//
+// Returns a pointer to the newly allocated HashTable.
+HashTable* HashTable_BuildFromArray(const HTKeyValue_t *keyvalues,
+                                   int n,
+                                   HTDupPolicy_t dup_policy,
+                                   const HTOptions *options);
+
+// Make room in a HashTable for num_elements elements in total, so that
+// the table won't need to resize before it holds that many.  A chained
+// table also preallocates any nodes it is short of in one contiguous
+// block.
+//
+// Arguments:
+// - table: the HashTable to reserve space in.
+// - num_elements: the number of elements to make room for (>= 0).
+void HashTable_Reserve(HashTable *table, int num_elements);
+
+// Right-size a HashTable for the elements it currently holds, releasing
+// the memory of any buckets (or flat slots) beyond that.  A chained table
+// is rebuilt at a load factor of 1, or of max_load_factor / 2 if that is
+// lower (see HTOptions); a flat table is rebuilt
+// at the smallest capacity that comfortably holds its elements, which also
+// clears out the tombstones left by removals.  A chained table keeps the
+// memory of its removed elements' nodes for later inserts to reuse.  Any
+// existing iterators on the table become undefined.
+//
+// Arguments:
+// - table: the HashTable to compact.
+void HashTable_Compact(HashTable *table);
+
 // Figure out the number of elements in the hash table.
 //
 // Arguments:
@@ -107,6 +282,247 @@ void HashTable_Free(HashTable *table, ValueFreeFnPtr value_free_function);
 // - table size (>=0)
 int HashTable_NumElements(HashTable *table);
 
+// The memory a HashTable holds, by what it's for.  Only memory the table
+// allocated itself is counted: not the memory values point to, and not
+// its iterators.
+typedef struct {
+  // The table record and its index: the bucket arrays and occupancy
+  // bitmaps (both the old and new ones during an incremental resize), or
+  // the flat engine's control bytes.
+  size_t index_bytes;
+
+  // Everything that holds elements, less the elements themselves: node
+  // links, slab page and arena chunk headers, nodes freed for reuse and
+  // not yet handed out, and the flat engine's empty slots.
+  size_t node_bytes;
+
+  // The (key, value) pairs of the elements in the table.
+  size_t entry_bytes;
+
+  // The sum of the above.
+  size_t total_bytes;
+} HTMemoryUsage;
+
+// Report how much memory a HashTable holds.  The numbers are kept up to
+// date as the table changes, so this is O(1) and cheap enough to export
+// as a gauge.
+//
+// Arguments:
+// - table: the table to query.
+//
+// Returns:
+// - the table's memory usage, in bytes.
+HTMemoryUsage HashTable_MemoryUsage(HashTable *table);
+
+// The number of chain lengths HTStats keeps a histogram of.
+#define HT_STATS_CHAIN_BINS 16
+
+// What a HashTable looks like, and what has been done to it.
+typedef struct {
+  // The table's shape, worked out by walking its buckets.  The chain
+  // fields are for the chained engine only, and are 0 for a flat table.
+  double   load_factor;  // elements per bucket (or flat slot)
+  int      max_chain;    // # of elements in the longest chain
+  double   mean_chain;   // mean # of elements in a non-empty chain
+
+  // chain_histogram[i] is the number of chains of length i (with the last
+  // bin also counting all longer chains), so chain_histogram[0] is the
+  // number of empty buckets.
+  uint64_t chain_histogram[HT_STATS_CHAIN_BINS];
+
+  // Counters kept since the table was allocated.  These are all 0 if the
+  // library was built with HT_DISABLE_STATS defined.
+  uint64_t finds;          // keys looked up: hits + misses
+  uint64_t hits;           // lookups that found their key
+  uint64_t misses;         // lookups that didn't
+  uint64_t inserts;        // elements added
+  uint64_t replacements;   // inserts that replaced an existing value
+  uint64_t removes;        // elements removed
+  uint64_t resizes;        // times the index was rebuilt, for any reason
+  uint64_t keys_compared;  // keys compared against while searching chains
+                           // (or flat slots whose tag matched)
+  uint64_t resize_nanos;   // time spent rebuilding the index.  For an
+                           // incremental resize, only the part done up
+                           // front is timed, not the later migration.
+} HTStats;
+
+// Report a HashTable's shape and activity.  The counters cost next to
+// nothing to keep, but the shape takes a walk over every bucket, so this
+// is O(buckets + elements).  HashTable_FindOrInsert counts as a find, plus
+// an insert on a miss.
+//
+// Arguments:
+// - table: the table to query.
+//
+// Returns:
+// - the table's statistics.
+HTStats HashTable_GetStats(HashTable *table);
+
+// Latency histograms.
+//
+// A library built with HT_ENABLE_LATENCY defined times every insert
+// (HashTable_Insert, HashTable_InsertBatch's inserts and
+// HashTable_FindOrInsert), find (HashTable_Find), remove (HashTable_Remove)
+// and index rebuild, and keeps a histogram of each per table.  Timing
+// costs a couple of clock reads per operation, so it's compiled out
+// entirely by default.
+//
+// Histograms are log-bucketed, in the style of HdrHistogram: every power
+// of two of nanoseconds is split into 8 linear buckets, so any recorded
+// latency is known to within 12.5%.
+
+// Which operation a latency histogram is for.
+typedef enum {
+  HT_LATENCY_INSERT,
+  HT_LATENCY_FIND,
+  HT_LATENCY_REMOVE,
+  HT_LATENCY_RESIZE,
+  HT_LATENCY_NUM_OPS
+} HTLatencyOp_t;
+
+// The number of buckets in a latency histogram: 8 for each power of two
+// of a 64-bit nanosecond count.
+#define HT_LATENCY_BUCKETS ((64 - 2) * 8)
+
+typedef struct {
+  uint64_t count;     // # of latencies recorded
+  uint64_t total_ns;  // their sum
+  uint64_t max_ns;    // the largest of them
+  uint64_t buckets[HT_LATENCY_BUCKETS];  // # of latencies in each bucket
+} HTLatencyHistogram;
+
+// Copy one of a table's latency histograms.
+//
+// Arguments:
+// - table: the table to query.
+// - op: the operation whose histogram to copy.
+// - histogram: where to copy it.
+//
+// Returns:
+// - true if latencies are being recorded, or false (with histogram
+//   zeroed) if the library was built without HT_ENABLE_LATENCY.
+bool HashTable_LatencySnapshot(HashTable *table, HTLatencyOp_t op,
+                               HTLatencyHistogram *histogram);
+
+// Clear all of a table's latency histograms.
+//
+// Arguments:
+// - table: the table whose histograms to clear.
+void HashTable_LatencyReset(HashTable *table);
+
+// Add a latency to a histogram.  Useful for merging samples from several
+// tables or runs.
+//
+// Arguments:
+// - histogram: the histogram to add to.
+// - ns: the latency, in nanoseconds.
+void HTLatency_Record(HTLatencyHistogram *histogram, uint64_t ns);
+
+// Add every latency in one histogram to another.
+//
+// Arguments:
+// - dst: the histogram to add to.
+// - src: the histogram to add.
+void HTLatency_Merge(HTLatencyHistogram *dst, const HTLatencyHistogram *src);
+
+// Estimate a percentile of the latencies in a histogram.
+//
+// Arguments:
+// - histogram: the histogram to query.
+// - percentile: which percentile, from 0 to 100 (eg, 99.9).
+//
+// Returns:
+// - the upper end of the bucket holding that percentile, capped at the
+//   largest latency recorded; 0 if the histogram is empty.
+uint64_t HTLatency_Percentile(const HTLatencyHistogram *histogram,
+                              double percentile);
+
+// Tracing.
+//
+// A table can log a compact binary record of every call made on it to a
+// file, so that a real workload can be captured once and then replayed
+// (see replay_hashtable.c) against any engine or policy.  Tracing is off
+// until HashTable_StartTrace is called, and costs a single branch per call
+// while it's off.
+//
+// A trace file is an 8-byte header, "HTTRACE1", followed by records of
+// HT_TRACE_RECORD_SIZE bytes each: the operation (one byte), the value's
+// size class (one byte), and the key (8 bytes, little-endian).  A size
+// class of 0 means the size is unknown; otherwise class c means the value
+// is at most 2^(c-1) bytes.
+//
+// Not every call can be replayed faithfully: HashTable_RemoveIf isn't
+// traced (its predicate can't be recorded), and an iterator is traced as
+// a full scan when it's allocated.
+
+// What a trace record is for.  The key field holds what's noted here.
+typedef enum {
+  HT_TRACE_BEGIN = 1,      // tracing started; key is the bucket count
+  HT_TRACE_INSERT,         // HashTable_Insert; key is the key
+  HT_TRACE_FIND,           // HashTable_Find or one key of FindBatch
+  HT_TRACE_FIND_OR_INSERT, // HashTable_FindOrInsert
+  HT_TRACE_REMOVE,         // HashTable_Remove or HTIterator_Remove
+  HT_TRACE_ITERATE,        // HTIterator_Allocate; key is unused
+  HT_TRACE_RESERVE,        // HashTable_Reserve; key is num_elements
+  HT_TRACE_COMPACT,        // HashTable_Compact; key is unused
+  HT_TRACE_FREE            // HashTable_Free; key is unused
+} HTTraceOp_t;
+
+#define HT_TRACE_RECORD_SIZE 10
+
+// One trace record, as read back by HTTrace_ReadRecord.
+typedef struct {
+  HTTraceOp_t op;
+  uint8_t     size_class;
+  HTKey_t     key;
+} HTTraceRecord;
+
+// Returns the size, in bytes, of the data a value points to.  Used to
+// record the size class of inserted values in a trace.
+typedef size_t(*HTValueSizeFnPtr)(HTValue_t value);
+
+// Start logging every call on a table to a file.  The header and a
+// HT_TRACE_BEGIN record are written immediately.  Start on an empty
+// table: a replay starts from an empty one.
+//
+// Arguments:
+// - table: the table to trace.  It must not already be tracing.
+// - file: where to write the trace, which should be empty.  It must stay
+//   open until tracing stops; the table never closes it.
+// - value_size: gives the size of each inserted value, or NULL to record
+//   every size class as 0.
+void HashTable_StartTrace(HashTable *table, FILE *file,
+                          HTValueSizeFnPtr value_size);
+
+// Stop tracing a table, flushing its trace file.  HashTable_Free does this
+// too.  Does nothing if the table isn't tracing.
+//
+// Arguments:
+// - table: the table to stop tracing.
+void HashTable_StopTrace(HashTable *table);
+
+// Read and check the header of a trace file.
+//
+// Arguments:
+// - file: the trace file, at its start.
+//
+// Returns:
+// - true if the file starts with a trace header, false otherwise.
+bool HTTrace_ReadHeader(FILE *file);
+
+// Read the next record of a trace file.
+//
+// Arguments:
+// - file: the trace file, after its header.
+// - record: where to return the record.
+//
+// Returns:
+// - true if a record was read, false at the end of the trace.
+bool HTTrace_ReadRecord(FILE *file, HTTraceRecord *record);
+
+// Return the size class (see above) of a value of size bytes.
+uint8_t HTTrace_SizeClass(size_t size);
+
 // Inserts a (key,value) pair into the HashTable.
 //
 // Arguments:
@@ -129,6 +545,25 @@ bool HashTable_Insert(HashTable *table,
                       HTKeyValue_t newkeyvalue,
                       HTKeyValue_t *oldkeyvalue);
 
+// Looks up a key in the HashTable, inserting it with a NULL value if it
+// is not already present, and returns where its value is stored.  This
+// lets a caller read, initialize or update a key's value with a single
+// probe of the table.
+//
+// Arguments:
+// - table: the HashTable to look in or insert into.
+// - key: the key to look up.
+// - slot: a return parameter; on return, points at the value stored for
+//   key.  The caller may read or write *slot directly.  The pointer is
+//   only valid until the next insertion into or removal from the table.
+// - inserted: a return parameter; on return, true if key was not present
+//   and has just been inserted (so **slot is NULL), or false if key was
+//   already present.
+void HashTable_FindOrInsert(HashTable *table,
+                            HTKey_t key,
+                            HTValue_t **slot,
+                            bool *inserted);
+
 // Looks up a key in the HashTable, and if it is present, returns the
 // (key,value) associated with it.
 //
@@ -170,6 +605,90 @@ bool HashTable_Remove(HashTable *table,
                       HTKey_t key,
                       HTKeyValue_t *keyvalue);
 
+// When removing (key,value) pairs in bulk with HashTable_RemoveIf, customers
+// pass in a predicate that picks which pairs to remove.  It is handed each
+// (key,value) in turn along with the customer's ctx pointer, and returns
+// true if that pair should be removed.  The predicate must not modify the
+// table.
+typedef bool(*HTPredicateFnPtr)(HTKeyValue_t keyvalue, void *ctx);
+
+// Removes every (key,value) pair in the HashTable that satisfies a
+// predicate, in a single pass over the table.  Any existing iterators on
+// the table become undefined.
+//
+// Arguments:
+// - table: the HashTable to remove from.
+// - predicate: a pointer to a predicate function; see above.
+// - ctx: passed through unchanged to every call of predicate.
+// - value_free_function: if non-NULL, invoked on the value of each removed
+//   pair.  If NULL, the removed values are simply dropped from the table
+//   and the caller stays responsible for them (eg, predicate may have
+//   recorded them through ctx).
+// - shrink: if true, and the removals leave the table less than half as
+//   full as growing would leave it (or, for a chained table with a
+//   min_load_factor, below that), the table is right-sized as
+//   HashTable_Compact would.  Both engines honor this.  If false, only a
+//   chained table with a min_load_factor shrinks, as after any removal.
+//
+// Returns:
+// - the number of (key,value) pairs removed (>= 0).
+int HashTable_RemoveIf(HashTable *table,
+                       HTPredicateFnPtr predicate,
+                       void *ctx,
+                       ValueFreeFnPtr value_free_function,
+                       bool shrink);
+
+// Looks up a batch of keys in the HashTable.  This behaves exactly like
+// calling HashTable_Find on each key in turn, but pipelines the lookups: a
+// key's bucket is prefetched well before the key is looked up, the head of
+// its chain once the bucket has arrived, and the rest of the chain a node
+// ahead as it's walked.  The cache misses of nearby keys overlap instead of
+// being taken one after another.
+//
+// Arguments:
+// - table: the HashTable to look in.
+// - keys: an array of n keys to look up.
+// - n: the number of keys (>= 0).
+// - keyvalues: an array of n return parameters.  If keys[i] is present,
+//   a copy of its (key,value) is returned through keyvalues[i]; as with
+//   HashTable_Find, it is left in the HashTable.
+// - found: an array of n return parameters; found[i] is set to whether
+//   keys[i] was present.
+//
+// Returns:
+// - the number of keys that were found.
+int HashTable_FindBatch(HashTable *table,
+                        const HTKey_t *keys,
+                        int n,
+                        HTKeyValue_t *keyvalues,
+                        bool *found);
+
+// Inserts a batch of (key,value) pairs into the HashTable.  This behaves
+// exactly like calling HashTable_Insert on each pair in order (so if a key
+// appears twice, the second insert replaces the first), but pipelines the
+// inserts the way HashTable_FindBatch pipelines lookups, inserting straight
+// into the prefetched buckets.  Inserts that resize the table, and those
+// made while an incremental resize is migrating it, can't use buckets found
+// in advance and are made one at a time as usual.
+//
+// Arguments:
+// - table: the HashTable to insert into.
+// - newkeyvalues: an array of n (key,value) pairs to insert.
+// - n: the number of pairs (>= 0).
+// - oldkeyvalues: an array of n return parameters.  If inserting
+//   newkeyvalues[i] replaced an old (key,value), it is returned through
+//   oldkeyvalues[i] and the caller assumes ownership of it.
+// - replaced: an array of n return parameters; replaced[i] is set to what
+//   HashTable_Insert would have returned for newkeyvalues[i].
+//
+// Returns:
+// - the number of pairs that replaced an existing (key,value).
+int HashTable_InsertBatch(HashTable *table,
+                          const HTKeyValue_t *newkeyvalues,
+                          int n,
+                          HTKeyValue_t *oldkeyvalues,
+                          bool *replaced);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // HashTable iterator
@@ -181,12 +700,18 @@ bool HashTable_Remove(HashTable *table,
 // is visited exactly once.  Also, if the customer uses a HashTable function
 // to mutate the hash table, any existing iterators become undefined (ie,
 // dangerous to use; arbitrary memory corruption can occur).
+//
+// Lookups leave iterators valid.  To keep it that way, while a table has
+// live iterators its lookups don't do their share of an incremental
+// resize; insertions and removals still do, so the resize is only paused
+// as long as the table isn't modified.
 typedef struct ht_it HTIterator;  // same trick to hide implementation.
 
 // Manufacture an iterator for the table.  If there are
 // elements in the hash table, the iterator is initialized
 // to point at the "first" one.  The caller is responsible
-// for eventually calling HTIterator_Free.
+// for eventually calling HTIterator_Free, which may happen before or
+// after the table itself is freed.
 //
 // Arguments:
 // - table:  the table from which to return an iterator.
@@ -197,7 +722,8 @@ typedef struct ht_it HTIterator;  // same trick to hide implementation.
 HTIterator* HTIterator_Allocate(HashTable *table);
 
 // When you're done with a hash table iterator, you must free it
-// by calling this function.
+// by calling this function.  Once its table has been freed, this is the
+// only thing an iterator may still be used for.
 //
 // Arguments:
 // - iter: the iterator to free.  Don't use it after freeing it.
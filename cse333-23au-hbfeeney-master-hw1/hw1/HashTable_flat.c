@@ -0,0 +1,353 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>  // for _mm_* group compares
+#endif
+
+#include "CSE333.h"
+#include "HashTable.h"
+#include "HashTable_priv.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// The flat engine is an open-addressing table in the style of "Swiss
+// tables".  Each slot has a one-byte control tag; a key's mixed hash is
+// split into H1 (which group of HT_FLAT_GROUP slots to start probing at)
+// and H2 (7 bits stored in the control byte).  A probe compares H2 against
+// a whole group of control bytes at once, so keys[] is only touched for
+// slots whose tag already matches.
+//
+// Groups are probed triangularly (g, g+1, g+3, g+6, ...), which visits
+// every group when the group count is a power of two.  A probe stops at
+// the first group containing an EMPTY slot, so the table always keeps at
+// least 1/8 of its slots EMPTY.
+
+// Number of slots we'll fill (including tombstones) before rehashing,
+// expressed as a fraction of capacity: 7/8.
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 8
+
+// Splits of the mixed hash.
+#define H1(h)  ((h) >> 7)
+#define H2(h)  ((uint8_t) (HT_FLAT_FULL | ((h) & 0x7F)))
+
+// Returns a bitmask with bit i set iff group[i] == tag.
+static inline uint32_t GroupMatch(const uint8_t *group, uint8_t tag) {
+#if defined(__SSE2__)
+  __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+  __m128i match = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) tag));
+  return (uint32_t) _mm_movemask_epi8(match);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < HT_FLAT_GROUP; i++) {
+    if (group[i] == tag) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+// Returns a bitmask with bit i set iff group[i] is a full slot.
+static inline uint32_t GroupMatchFull(const uint8_t *group) {
+#if defined(__SSE2__)
+  // Full slots are exactly the ones with their high bit set.
+  __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+  return (uint32_t) _mm_movemask_epi8(ctrl);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < HT_FLAT_GROUP; i++) {
+    if (group[i] & HT_FLAT_FULL) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+// Returns a bitmask with bit i set iff group[i] is EMPTY or DELETED.
+static inline uint32_t GroupMatchAvailable(const uint8_t *group) {
+  return ~GroupMatchFull(group) & ((1u << HT_FLAT_GROUP) - 1);
+}
+
+static inline int NumGroups(HashTable *ht) {
+  return ht->num_buckets / HT_FLAT_GROUP;
+}
+
+// Returns the slot holding key, or INVALID_IDX if it isn't present.
+static int FindSlot(HashTable *ht, HTKey_t key) {
+  uint64_t h = HashKeyMix(key);
+  uint8_t tag = H2(h);
+  int group_mask = NumGroups(ht) - 1;
+  int g = (int) (H1(h) & group_mask);
+
+  for (int step = 1; ; step++) {
+    const uint8_t *group = ht->ctrl + g * HT_FLAT_GROUP;
+    uint32_t match = GroupMatch(group, tag);
+
+    // Only slots whose tag matched need their key compared.
+    while (match != 0) {
+      int slot = g * HT_FLAT_GROUP + __builtin_ctz(match);
+      HT_STAT_INC(ht, keys_compared);
+      if (ht->keys[slot] == key) {
+        return slot;
+      }
+      match &= match - 1;
+    }
+
+    // An EMPTY slot in this group means the key was never pushed further.
+    if (GroupMatch(group, HT_FLAT_EMPTY) != 0) {
+      return INVALID_IDX;
+    }
+    g = (g + step) & group_mask;
+  }
+}
+
+// Returns the first EMPTY or DELETED slot along key's probe sequence.
+// The table must not already contain key.
+static int FindAvailableSlot(HashTable *ht, HTKey_t key) {
+  uint64_t h = HashKeyMix(key);
+  int group_mask = NumGroups(ht) - 1;
+  int g = (int) (H1(h) & group_mask);
+
+  for (int step = 1; ; step++) {
+    uint32_t avail = GroupMatchAvailable(ht->ctrl + g * HT_FLAT_GROUP);
+    if (avail != 0) {
+      return g * HT_FLAT_GROUP + __builtin_ctz(avail);
+    }
+    g = (g + step) & group_mask;
+  }
+}
+
+// Allocates arrays for num_slots slots (a power of two, >= HT_FLAT_GROUP)
+// and installs them in ht.
+static void AllocateSlots(HashTable *ht, int num_slots) {
+  ht->num_buckets = num_slots;
+  ht->num_deleted = 0;
+  ht->ctrl =
+      (uint8_t *) Allocator_Calloc(&ht->allocator, num_slots, sizeof(uint8_t));
+  ht->keys = (HTKey_t *)
+      Allocator_Alloc(&ht->allocator, num_slots * sizeof(HTKey_t));
+  ht->values = (HTValue_t *)
+      Allocator_Alloc(&ht->allocator, num_slots * sizeof(HTValue_t));
+}
+
+// Frees arrays for num_slots slots from AllocateSlots.
+static void FreeSlots(HashTable *ht, uint8_t *ctrl, HTKey_t *keys,
+                      HTValue_t *values, int num_slots) {
+  Allocator_Free(&ht->allocator, ctrl, num_slots * sizeof(uint8_t));
+  Allocator_Free(&ht->allocator, keys, num_slots * sizeof(HTKey_t));
+  Allocator_Free(&ht->allocator, values, num_slots * sizeof(HTValue_t));
+}
+
+// Moves every entry into freshly allocated arrays of num_slots slots,
+// dropping all tombstones along the way.
+static void Rehash(HashTable *ht, int num_slots) {
+  uint8_t   *old_ctrl = ht->ctrl;
+  HTKey_t   *old_keys = ht->keys;
+  HTValue_t *old_values = ht->values;
+  int        old_num_slots = ht->num_buckets;
+  uint64_t   start = HTClock();
+
+  AllocateSlots(ht, num_slots);
+
+  // Every key is unique, so there's no need to look for duplicates.
+  for (int i = 0; i < old_num_slots; i++) {
+    if (old_ctrl[i] & HT_FLAT_FULL) {
+      int slot = FindAvailableSlot(ht, old_keys[i]);
+      ht->ctrl[slot] = old_ctrl[i];
+      ht->keys[slot] = old_keys[i];
+      ht->values[slot] = old_values[i];
+    }
+  }
+
+  FreeSlots(ht, old_ctrl, old_keys, old_values, old_num_slots);
+  HT_STAT_INC(ht, resizes);
+  HT_STAT_ADD(ht, resize_nanos, HTClock() - start);
+  HT_LATENCY_RECORD(ht, HT_LATENCY_RESIZE, start);
+}
+
+// Returns the smallest number of slots, at least min_slots, in which
+// num_entries live entries fill at most half of the max load.
+static int SlotsFor(int num_entries, int min_slots) {
+  int num_slots = min_slots;
+  while ((int64_t) num_entries * 2 * MAX_LOAD_DEN >
+         (int64_t) num_slots * MAX_LOAD_NUM) {
+    num_slots *= 2;
+  }
+  return num_slots;
+}
+
+// Makes room for one more entry.  If tombstones are what's filling the
+// table we just rehash in place; otherwise we double the capacity.
+static void MaybeGrow(HashTable *ht) {
+  int used = ht->num_elements + ht->num_deleted + 1;
+  if ((int64_t) used * MAX_LOAD_DEN <= (int64_t) ht->num_buckets * MAX_LOAD_NUM)
+    return;
+  Rehash(ht, SlotsFor(ht->num_elements + 1, ht->num_buckets));
+}
+
+// Claims a slot for key, which must not already be in the table, growing
+// first if need be.  Returns the slot; its value is left for the caller to
+// fill in.
+static int InsertNew(HashTable *ht, HTKey_t key) {
+  MaybeGrow(ht);
+
+  int slot = FindAvailableSlot(ht, key);
+  if (ht->ctrl[slot] == HT_FLAT_DELETED) {
+    ht->num_deleted--;
+  }
+  ht->ctrl[slot] = H2(HashKeyMix(key));
+  ht->keys[slot] = key;
+  ht->num_elements++;
+  return slot;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Flat engine entry points.
+
+void HTFlat_Init(HashTable *ht, int num_slots) {
+  int n = HT_FLAT_GROUP;
+
+  Verify333(num_slots > 0);
+  while (n < num_slots) {
+    n *= 2;
+  }
+  AllocateSlots(ht, n);
+}
+
+void HTFlat_Free(HashTable *ht, ValueFreeFnPtr value_free_function) {
+  // Jump between full slots, stopping after the last element.
+  int slot = HTFlat_NextFull(ht, 0);
+  for (int i = 0; value_free_function != NULL && i < ht->num_elements; i++) {
+    value_free_function(ht->values[slot]);
+    slot = HTFlat_NextFull(ht, slot + 1);
+  }
+  FreeSlots(ht, ht->ctrl, ht->keys, ht->values, ht->num_buckets);
+}
+
+HTValue_t *HTFlat_FindOrInsert(HashTable *ht, HTKey_t key, bool *inserted) {
+  int slot = FindSlot(ht, key);
+
+  *inserted = (slot == INVALID_IDX);
+  if (*inserted) {
+    slot = InsertNew(ht, key);
+    ht->values[slot] = NULL;
+  }
+  return &ht->values[slot];
+}
+
+void HTFlat_InsertUnique(HashTable *ht, HTKeyValue_t newkeyvalue) {
+  ht->values[InsertNew(ht, newkeyvalue.key)] = newkeyvalue.value;
+}
+
+bool HTFlat_Insert(HashTable *ht, HTKeyValue_t newkeyvalue,
+                   HTKeyValue_t *oldkeyvalue) {
+  bool inserted;
+  HTValue_t *value = HTFlat_FindOrInsert(ht, newkeyvalue.key, &inserted);
+
+  // Replace the value in place if the key was already present.
+  if (!inserted) {
+    oldkeyvalue->key = newkeyvalue.key;
+    oldkeyvalue->value = *value;
+  }
+  *value = newkeyvalue.value;
+  return !inserted;
+}
+
+bool HTFlat_Find(HashTable *ht, HTKey_t key, HTKeyValue_t *keyvalue) {
+  int slot = FindSlot(ht, key);
+  if (slot == INVALID_IDX) {
+    return false;
+  }
+  keyvalue->key = ht->keys[slot];
+  keyvalue->value = ht->values[slot];
+  return true;
+}
+
+bool HTFlat_Remove(HashTable *ht, HTKey_t key, HTKeyValue_t *keyvalue) {
+  int slot = FindSlot(ht, key);
+  if (slot == INVALID_IDX) {
+    return false;
+  }
+  keyvalue->key = ht->keys[slot];
+  keyvalue->value = ht->values[slot];
+  HTFlat_RemoveSlot(ht, slot);
+  return true;
+}
+
+void HTFlat_RemoveSlot(HashTable *ht, int slot) {
+  // A group that still has an EMPTY slot has never been probed past (a
+  // probe stops at the first EMPTY it sees), so its slots can go straight
+  // back to EMPTY.  Otherwise leave a tombstone to keep probes going.
+  const uint8_t *group = ht->ctrl + (slot / HT_FLAT_GROUP) * HT_FLAT_GROUP;
+  if (GroupMatch(group, HT_FLAT_EMPTY) != 0) {
+    ht->ctrl[slot] = HT_FLAT_EMPTY;
+  } else {
+    ht->ctrl[slot] = HT_FLAT_DELETED;
+    ht->num_deleted++;
+  }
+  ht->num_elements--;
+}
+
+void HTFlat_Reserve(HashTable *ht, int num_entries) {
+  // SlotsFor leaves live entries at most half the max load, so growing
+  // only when that would add capacity keeps the slack for tombstones.
+  int num_slots = SlotsFor(num_entries, ht->num_buckets);
+  if (num_slots > ht->num_buckets) {
+    Rehash(ht, num_slots);
+  }
+}
+
+void HTFlat_Compact(HashTable *ht) {
+  Rehash(ht, SlotsFor(ht->num_elements, HT_FLAT_GROUP));
+}
+
+void HTFlat_Shrink(HashTable *ht) {
+  // Growing leaves live entries at most half the max load, and compacting
+  // leaves them over a quarter of it, so a quarter is where to shrink.
+  if ((int64_t) ht->num_elements * 4 * MAX_LOAD_DEN <
+      (int64_t) ht->num_buckets * MAX_LOAD_NUM) {
+    HTFlat_Compact(ht);
+  }
+}
+
+void HTFlat_Prefetch(HashTable *ht, HTKey_t key) {
+  uint64_t h = HashKeyMix(key);
+  int g = (int) (H1(h) & (NumGroups(ht) - 1));
+
+  __builtin_prefetch(ht->ctrl + g * HT_FLAT_GROUP);
+  __builtin_prefetch(ht->keys + g * HT_FLAT_GROUP);
+}
+
+int HTFlat_NextFull(HashTable *ht, int start) {
+  if (start >= ht->num_buckets) {
+    return INVALID_IDX;
+  }
+
+  // Mask off the slots before start in its group, then skip whole groups
+  // until one has a full slot.
+  int g = start / HT_FLAT_GROUP;
+  uint32_t full = GroupMatchFull(ht->ctrl + g * HT_FLAT_GROUP) &
+                  (~0u << (start % HT_FLAT_GROUP));
+  while (full == 0) {
+    if (++g >= NumGroups(ht)) {
+      return INVALID_IDX;
+    }
+    full = GroupMatchFull(ht->ctrl + g * HT_FLAT_GROUP);
+  }
+  return g * HT_FLAT_GROUP + __builtin_ctz(full);
+}
@@ -14,8 +14,9 @@
 
 #include <stdint.h>  // for uint32_t, etc.
 
-#include "./LinkedList.h"
 #include "./HashTable.h"
+#include "./Slab.h"   // for Slab
+#include "./Arena.h"  // for Arena
 
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 // Internal structures and helper functions for our HashTable implementation.
@@ -29,25 +30,206 @@
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
 
+// A single entry in a chained bucket.
+//
+// The (key,value) is stored inline, so an entry costs one allocation and a
+// lookup one dependent load per node.  Chains are singly linked: every
+// removal walks the chain from its head, so it already knows the
+// predecessor and has no use for a prev pointer.
+typedef struct ht_node {
+  HTKeyValue_t    kv;    // the (key,value) stored in this node
+  struct ht_node *next;  // next node in the chain, or NULL
+} HTNode;
+
 // The hash table implementation.
 //
-// A hash table is an array of buckets, where each bucket is a linked list
-// of HTKeyValue structs.
+// For the chained engine, a hash table is an array of buckets, where each
+// bucket is a singly-linked chain of HTNodes (NULL if the bucket is empty).
+// Alongside it, the occupied bitmap has bit i set iff bucket i is non-empty,
+// which lets iteration jump straight between occupied buckets.
+//
+// While an incremental resize is in progress (old_buckets != NULL), entries
+// live in two bucket arrays.  Old buckets below migrate_idx have already been
+// moved into buckets and are empty; the rest still hold their chains.  Each
+// operation moves a few more.  Lookups skip their share while any
+// HTIterator is live, so that iterators see a stable layout.
+//
+// For the flat engine, num_buckets is the number of slots.  Slot i is
+// described by ctrl[i], and if it is full its (key,value) lives in keys[i]
+// and values[i].  Slots are probed in aligned groups of HT_FLAT_GROUP.
 typedef struct ht {
   int             num_buckets;   // # of buckets in this HT?
   int             num_elements;  // # of elements currently in this HT?
-  LinkedList    **buckets;       // the array of buckets
+  HTNode        **buckets;       // the array of buckets
+  uint64_t       *occupied;      // bitmap of non-empty buckets
+  HTEngine_t      engine;        // which engine backs this HT
+  HTIndexMode_t   index_mode;    // how keys map to buckets
+  struct ht_it   *iterators;     // live HTIterators on this HT, listed
+  double          max_load_factor;  // grow at this load
+  double          growth_factor;    // multiply num_buckets by this to grow
+  double          min_load_factor;  // shrink below this load, if > 0
+
+  // Incremental resize state (chained engine only).
+  bool            incremental;      // resize incrementally?
+  HTNode        **old_buckets;      // buckets being migrated, or NULL
+  uint64_t       *old_occupied;     // bitmap of non-empty old_buckets
+  int             old_num_buckets;  // # of buckets in old_buckets
+  int             migrate_idx;      // next old bucket to migrate
+
+  // Where the chained engine's nodes come from.  Every table has its own,
+  // so a table's nodes are packed together in memory.  In arena mode the
+  // slab's pages come from the table's arena.
+  Slab            node_slab;
+  bool            use_arena;  // allocate node pages from arena?
+  Arena           arena;      // the arena, if use_arena
+  Allocator       allocator;  // where all other memory comes from
+
+  // Flat engine state; unused (NULL/0) for the chained engine.
+  int             num_deleted;   // # of HT_FLAT_DELETED tombstones
+  uint8_t        *ctrl;          // one control byte per slot
+  HTKey_t        *keys;          // slot keys
+  HTValue_t      *values;        // slot values
+
+  // Operation counters for HashTable_GetStats (whose shape fields are
+  // left zero here).
+  HTStats         stats;
+
+  // Where this table's calls are traced to, or NULL if they aren't.
+  FILE             *trace;
+  HTValueSizeFnPtr  trace_value_size;  // may be NULL
+
+#ifdef HT_ENABLE_LATENCY
+  // Latency histograms, indexed by HTLatencyOp_t.
+  HTLatencyHistogram latency[HT_LATENCY_NUM_OPS];
+#endif
 } HashTable;
 
+// Flat engine control bytes.  A full slot's control byte has its high bit
+// set and holds 7 bits of the key's mixed hash; empty slots are zero so a
+// freshly calloc'ed control array is all-empty.
+#define HT_FLAT_GROUP   16
+#define HT_FLAT_EMPTY   0x00
+#define HT_FLAT_DELETED 0x01
+#define HT_FLAT_FULL    0x80
+
 // The hash table iterator.
+// Live iterators are listed on their table, which detaches them (setting
+// ht to NULL) when it is freed, so that an iterator can still be freed
+// afterwards.
 typedef struct ht_it {
-  HashTable  *ht;          // the HT we're pointing into
-  int         bucket_idx;  // which bucket are we in?
-  LLIterator *bucket_it;   // iterator for the bucket, or NULL
+  HashTable    *ht;          // the HT we're pointing into, or NULL
+  int           bucket_idx;  // which bucket (or flat slot) are we in?
+  HTNode      **link;        // chained engine: the link to the node we're
+                             // at (so it can be unlinked), or NULL
+  struct ht_it *prev;        // neighbours in ht's list of iterators
+  struct ht_it *next;
+  Allocator     allocator;   // what the iterator was allocated with
 } HTIterator;
 
 // This is the internal hash function we use to map from HTKey_t keys to a
 // bucket number.
 int HashKeyToBucketNum(HashTable *ht, HTKey_t key);
 
+// Bump one of a table's operation counters (see HTStats).  They're plain
+// adds to the table record, so they're cheap, but building with
+// -DHT_DISABLE_STATS compiles them out altogether.
+#ifndef HT_DISABLE_STATS
+#define HT_STAT_ADD(ht, counter, n) ((ht)->stats.counter += (n))
+#else
+#define HT_STAT_ADD(ht, counter, n) ((void) (n))
+#endif
+#define HT_STAT_INC(ht, counter) HT_STAT_ADD(ht, counter, 1)
+
+// Time an operation for its latency histogram (see HTLatencyOp_t): take
+// start = HT_LATENCY_CLOCK() before it, and HT_LATENCY_RECORD it after.
+// Both compile to nothing unless HT_ENABLE_LATENCY is defined.
+#ifdef HT_ENABLE_LATENCY
+#define HT_LATENCY_CLOCK() HTClock()
+#define HT_LATENCY_RECORD(ht, op, start) \
+  HTLatency_Record(&(ht)->latency[op], HTClock() - (start))
+#else
+#define HT_LATENCY_CLOCK() ((uint64_t) 0)
+#define HT_LATENCY_RECORD(ht, op, start) ((void) (start))
+#endif
+
+// Log a call on ht to its trace, if it's tracing.  value is the inserted
+// value, for its size class, or NULL.
+#define HT_TRACE(ht, op, key, value) \
+  do { \
+    if ((ht)->trace != NULL) { \
+      HTTrace_Record((ht), (op), (key), (value)); \
+    } \
+  } while (0)
+
+// Write a trace record for ht, which must be tracing.  Use HT_TRACE.
+void HTTrace_Record(HashTable *ht, HTTraceOp_t op, HTKey_t key,
+                    HTValue_t value);
+
+// Returns a monotonic timestamp in nanoseconds for timing resizes and
+// latencies, or 0 if both stats and latencies are compiled out.
+uint64_t HTClock(void);
+
+// The size of the chunks an arena-mode table allocates.
+#define HT_ARENA_CHUNK_SIZE (1 << 20)
+
+// The number of old buckets an incremental resize migrates per operation.
+#define HT_MIGRATE_BUCKETS 8
+
+// How far ahead of the key they're resolving HashTable_FindBatch and
+// HashTable_InsertBatch prefetch: each key's bucket is prefetched this many
+// keys early, and the head of its chain half as many.  A power of two.
+#define HT_BATCH_WINDOW 16
+
+// A 64-bit finalizer that spreads every input bit across the whole output.
+// Used wherever the engine needs more hash quality than the raw key offers.
+uint64_t HashKeyMix(HTKey_t key);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Flat (open addressing) engine, implemented in HashTable_flat.c.  The public
+// HashTable_* and HTIterator_* functions dispatch here when ht->engine is
+// HT_ENGINE_FLAT; each has the same contract as its public counterpart.
+
+// Set up the flat engine's arrays in an already-allocated ht record, with
+// room for at least num_slots slots.
+void HTFlat_Init(HashTable *ht, int num_slots);
+
+// Free the flat engine's arrays, calling value_free_function (if non-NULL)
+// on each value.
+void HTFlat_Free(HashTable *ht, ValueFreeFnPtr value_free_function);
+
+bool HTFlat_Insert(HashTable *ht, HTKeyValue_t newkeyvalue,
+                   HTKeyValue_t *oldkeyvalue);
+HTValue_t *HTFlat_FindOrInsert(HashTable *ht, HTKey_t key, bool *inserted);
+bool HTFlat_Find(HashTable *ht, HTKey_t key, HTKeyValue_t *keyvalue);
+bool HTFlat_Remove(HashTable *ht, HTKey_t key, HTKeyValue_t *keyvalue);
+
+// Empties the full slot at index slot.  Used by HTIterator_Remove, which
+// already knows the slot and so needs no probe.
+void HTFlat_RemoveSlot(HashTable *ht, int slot);
+
+// Rehashes into the smallest capacity that comfortably fits the current
+// entries, dropping all tombstones.
+void HTFlat_Compact(HashTable *ht);
+
+// Compacts ht if it's less than half as full as growing leaves it, for
+// HashTable_RemoveIf's shrink.
+void HTFlat_Shrink(HashTable *ht);
+
+// Grows, if needed, so that num_entries entries fit without growing again.
+void HTFlat_Reserve(HashTable *ht, int num_entries);
+
+// Inserts a (key,value) whose key is known not to be in the table.
+void HTFlat_InsertUnique(HashTable *ht, HTKeyValue_t newkeyvalue);
+
+// Prefetches the control bytes and keys key's probe would start at.  Used
+// by the batch operations.
+void HTFlat_Prefetch(HashTable *ht, HTKey_t key);
+
+// Returns the index of the first full slot at or after start, or
+// INVALID_IDX if there is none.  Used to drive HTIterator.
+int HTFlat_NextFull(HashTable *ht, int start);
+
+#define INVALID_IDX -1
+
 #endif  // HW1_HASHTABLE_PRIV_H_
@@ -0,0 +1,100 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CSE333.h"
+#include "HashTable.h"
+#include "HashTable_priv.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Call tracing; see HashTable_StartTrace for the file format.  Records are
+// written through stdio, so tracing a call usually costs a memcpy into the
+// file's buffer.
+
+static const char kTraceMagic[8] = { 'H', 'T', 'T', 'R', 'A', 'C', 'E', '1' };
+
+uint8_t HTTrace_SizeClass(size_t size) {
+  uint8_t size_class = 1;
+
+  if (size == 0) {
+    return 0;
+  }
+  while (size_class < 64 && ((size_t) 1 << (size_class - 1)) < size) {
+    size_class++;
+  }
+  return size_class;
+}
+
+void HTTrace_Record(HashTable *ht, HTTraceOp_t op, HTKey_t key,
+                    HTValue_t value) {
+  uint8_t record[HT_TRACE_RECORD_SIZE];
+
+  record[0] = (uint8_t) op;
+  record[1] = 0;
+  if (value != NULL && ht->trace_value_size != NULL) {
+    record[1] = HTTrace_SizeClass(ht->trace_value_size(value));
+  }
+  for (int i = 0; i < 8; i++) {
+    record[2 + i] = (uint8_t) (key >> (8 * i));
+  }
+  Verify333(fwrite(record, sizeof(record), 1, ht->trace) == 1);
+}
+
+void HashTable_StartTrace(HashTable *table, FILE *file,
+                          HTValueSizeFnPtr value_size) {
+  Verify333(table != NULL);
+  Verify333(file != NULL);
+  Verify333(table->trace == NULL);
+
+  Verify333(fwrite(kTraceMagic, sizeof(kTraceMagic), 1, file) == 1);
+  table->trace = file;
+  table->trace_value_size = value_size;
+  HTTrace_Record(table, HT_TRACE_BEGIN, table->num_buckets, NULL);
+}
+
+void HashTable_StopTrace(HashTable *table) {
+  Verify333(table != NULL);
+
+  if (table->trace != NULL) {
+    fflush(table->trace);
+    table->trace = NULL;
+    table->trace_value_size = NULL;
+  }
+}
+
+bool HTTrace_ReadHeader(FILE *file) {
+  char magic[sizeof(kTraceMagic)];
+
+  Verify333(file != NULL);
+  return fread(magic, sizeof(magic), 1, file) == 1 &&
+         memcmp(magic, kTraceMagic, sizeof(magic)) == 0;
+}
+
+bool HTTrace_ReadRecord(FILE *file, HTTraceRecord *record) {
+  uint8_t bytes[HT_TRACE_RECORD_SIZE];
+
+  Verify333(file != NULL);
+  Verify333(record != NULL);
+  if (fread(bytes, sizeof(bytes), 1, file) != 1) {
+    return false;
+  }
+  record->op = (HTTraceOp_t) bytes[0];
+  record->size_class = bytes[1];
+  record->key = 0;
+  for (int i = 0; i < 8; i++) {
+    record->key |= (HTKey_t) bytes[2 + i] << (8 * i);
+  }
+  return true;
+}
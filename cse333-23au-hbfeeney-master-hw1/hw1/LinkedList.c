@@ -21,14 +21,22 @@
 // LinkedList implementation.
 
 LinkedList* LinkedList_Allocate(void) {
+  return LinkedList_AllocateWithAllocator(NULL);
+}
+
+LinkedList* LinkedList_AllocateWithAllocator(const Allocator *allocator) {
   // Allocate the linked list record.
-  LinkedList *ll = (LinkedList *) malloc(sizeof(LinkedList));
-  Verify333(ll != NULL);
+  Allocator record_allocator;
+  Allocator_Init(&record_allocator, allocator);
+  LinkedList *ll =
+      (LinkedList *) Allocator_Alloc(&record_allocator, sizeof(LinkedList));
 
   // STEP 1: initialize the newly allocated record structure.
   ll->num_elements = 0;
   ll->head = NULL;
   ll->tail = NULL;
+  ll->allocator = record_allocator;
+  Slab_Init(&ll->node_slab, sizeof(LinkedListNode), allocator);
 
   // Return our newly minted linked list.
   return ll;
@@ -46,16 +54,17 @@ void LinkedList_Free(LinkedList *list,
   // Track the current node, starting with the head of the list.
   LinkedListNode *curr = list->head;
 
-  // Continue to free the current node as long as it is non-null.
+  // Continue to free the current node's payload as long as it is non-null.
   while (curr != NULL) {
     payload_free_function(curr->payload);
-    LinkedListNode *next = curr->next;
-    free(curr);
-    curr = next;
+    curr = curr->next;
   }
 
-  // Free the whole LinkedList.
-  free(list);
+  // The nodes all live in the list's slab, so releasing it frees them in
+  // one go.  Then free the whole LinkedList.
+  Slab_Release(&list->node_slab);
+  Allocator allocator = list->allocator;
+  Allocator_Free(&allocator, list, sizeof(LinkedList));
 }
 
 int LinkedList_NumElements(LinkedList *list) {
@@ -63,12 +72,25 @@ int LinkedList_NumElements(LinkedList *list) {
   return list->num_elements;
 }
 
+LLMemoryUsage LinkedList_MemoryUsage(LinkedList *list) {
+  LLMemoryUsage usage;
+
+  Verify333(list != NULL);
+
+  // The slab keeps a running total of the pages it holds.
+  usage.list_bytes = sizeof(LinkedList);
+  usage.payload_bytes = (size_t) list->num_elements * sizeof(LLPayload_t);
+  usage.node_bytes = Slab_NumBytes(&list->node_slab) - usage.payload_bytes;
+  usage.total_bytes =
+      usage.list_bytes + usage.node_bytes + usage.payload_bytes;
+  return usage;
+}
+
 void LinkedList_Push(LinkedList *list, LLPayload_t payload) {
   Verify333(list != NULL);
 
   // Allocate space for the new node.
-  LinkedListNode *ln = (LinkedListNode *) malloc(sizeof(LinkedListNode));
-  Verify333(ln != NULL);
+  LinkedListNode *ln = (LinkedListNode *) Slab_Alloc(&list->node_slab);
 
   // Set the payload
   ln->payload = payload;
@@ -134,7 +156,7 @@ bool LinkedList_Pop(LinkedList *list, LLPayload_t *payload_ptr) {
   list->num_elements--;
 
   // Free the memory allocated for the popped node.
-  free(popped_node_ptr);
+  Slab_Free(&list->node_slab, popped_node_ptr);
 
   return true;
 }
@@ -147,8 +169,7 @@ void LinkedList_Append(LinkedList *list, LLPayload_t payload) {
   // instead of the beginning.
 
   // Allocate space for the new node.
-  LinkedListNode *ln = (LinkedListNode *) malloc(sizeof(LinkedListNode));
-  Verify333(ln != NULL);
+  LinkedListNode *ln = (LinkedListNode *) Slab_Alloc(&list->node_slab);
 
   // Initialize the node.
   ln->next = NULL;
@@ -204,6 +225,21 @@ void LinkedList_Sort(LinkedList *list, bool ascending,
   } while (swapped);
 }
 
+bool LinkedList_Find(LinkedList *list, LLPayload_t target,
+                     LLPayloadComparatorFnPtr comparator_function,
+                     LLPayload_t *payload_ptr) {
+  Verify333(list != NULL);
+  Verify333(comparator_function != NULL);
+
+  for (LinkedListNode *node = list->head; node != NULL; node = node->next) {
+    if (comparator_function(node->payload, target) == 0) {
+      *payload_ptr = node->payload;
+      return true;
+    }
+  }
+  return false;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // LLIterator implementation.
@@ -212,19 +248,36 @@ LLIterator* LLIterator_Allocate(LinkedList *list) {
   Verify333(list != NULL);
 
   // OK, let's manufacture an iterator.
-  LLIterator *li = (LLIterator *) malloc(sizeof(LLIterator));
-  Verify333(li != NULL);
+  LLIterator *li =
+      (LLIterator *) Allocator_Alloc(&list->allocator, sizeof(LLIterator));
 
-  // Set up the iterator.
-  li->list = list;
-  li->node = list->head;
+  // Set up the iterator.  It keeps its own copy of the allocator, so that
+  // it can be freed even after the list has been.
+  LLIterator_Init(li, list);
+  li->allocator = list->allocator;
+  li->allocated = true;
 
   return li;
 }
 
+void LLIterator_Init(LLIterator *iter, LinkedList *list) {
+  Verify333(iter != NULL);
+  Verify333(list != NULL);
+
+  iter->list = list;
+  iter->node = list->head;
+
+  // A caller-owned iterator wasn't allocated, and LLIterator_Free refuses
+  // it.  LLIterator_Allocate overrides both fields after this.
+  Allocator_Init(&iter->allocator, NULL);
+  iter->allocated = false;
+}
+
 void LLIterator_Free(LLIterator *iter) {
   Verify333(iter != NULL);
-  free(iter);
+  Verify333(iter->allocated);
+  Allocator allocator = iter->allocator;
+  Allocator_Free(&allocator, iter, sizeof(LLIterator));
 }
 
 bool LLIterator_IsValid(LLIterator *iter) {
@@ -310,7 +363,7 @@ bool LLIterator_Remove(LLIterator *iter,
     iter->node = curr->next;
 
     // Free the current node.
-    free(curr);
+    Slab_Free(&iter->list->node_slab, curr);
   }
 
   // Free the payload.
@@ -357,7 +410,7 @@ bool LLSlice(LinkedList *list, LLPayload_t *payload_ptr) {
   list->num_elements--;
 
   // Free the sliced node.
-  free(sliced_node_ptr);
+  Slab_Free(&list->node_slab, sliced_node_ptr);
 
   return true;
 }
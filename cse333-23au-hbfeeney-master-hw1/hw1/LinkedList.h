@@ -15,6 +15,8 @@
 #include <stdbool.h>    // for bool type (true, false)
 #include <stdint.h>     // for uint64_t, etc.
 
+#include "./Allocator.h"  // for Allocator
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // A LinkedList is a doubly-linked list.
@@ -56,6 +58,17 @@ typedef void(*LLPayloadFreeFnPtr)(LLPayload_t payload);
 // - the newly-allocated linked list (never NULL).
 LinkedList* LinkedList_Allocate(void);
 
+// Like LinkedList_Allocate, but every allocation the list makes (its
+// record, its nodes, and its iterators) is done through allocator.
+//
+// Arguments:
+// - allocator: where the list gets its memory, or NULL for malloc and free.
+//   The list keeps a copy of it.
+//
+// Returns:
+// - the newly-allocated linked list (never NULL).
+LinkedList* LinkedList_AllocateWithAllocator(const Allocator *allocator);
+
 // Free a linked list that was previously allocated by LinkedList_Allocate.
 //
 // Arguments:
@@ -75,6 +88,25 @@ void LinkedList_Free(LinkedList *list,
 // - list length.
 int LinkedList_NumElements(LinkedList *list);
 
+// The memory a LinkedList holds, by what it's for.  Only memory the list
+// allocated itself is counted: not the memory payloads point to, and not
+// its iterators.
+typedef struct {
+  size_t list_bytes;     // the list record
+  size_t node_bytes;     // node links, page headers and unused nodes
+  size_t payload_bytes;  // the payloads of the elements in the list
+  size_t total_bytes;    // the sum of the above
+} LLMemoryUsage;
+
+// Report how much memory a LinkedList holds.  This is O(1).
+//
+// Arguments:
+// - list: the list to query.
+//
+// Returns:
+// - the list's memory usage, in bytes.
+LLMemoryUsage LinkedList_MemoryUsage(LinkedList *list);
+
 // Adds a new element to the head of the linked list.
 //
 // Arguments:
@@ -128,6 +160,25 @@ typedef int(*LLPayloadComparatorFnPtr)(LLPayload_t payload_a,
 void LinkedList_Sort(LinkedList *list, bool ascending,
                      LLPayloadComparatorFnPtr comparator_function);
 
+// Searches a LinkedList, from head to tail, for a payload that compares
+// equal to target.  This walks the nodes directly and allocates nothing.
+//
+// Arguments:
+// - list: the list to search.
+// - target: the payload to search for; passed as payload_b to
+//   comparator_function.
+// - comparator_function: a pointer to a payload comparator function; see
+//   above.  A payload matches when this returns 0.
+// - payload_ptr: a return parameter; if a match is found, the matching
+//   payload is returned through this parameter.
+//
+// Returns:
+// - false if no payload in the list matches target.
+// - true if one does.
+bool LinkedList_Find(LinkedList *list, LLPayload_t target,
+                     LLPayloadComparatorFnPtr comparator_function,
+                     LLPayload_t *payload_ptr);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Linked list iterator.
@@ -136,12 +187,25 @@ void LinkedList_Sort(LinkedList *list, bool ascending,
 // You use an iterator to navigate forward through the linked list and remove
 // elements from the list.  You use LLIterator_Allocate() to manufacture a new
 // iterator and LLIterator_Free() to free an iterator when you're done with it.
+// Alternatively, you can declare an LLIterator yourself (eg, on the stack) and
+// set it up with LLIterator_Init(), which needs no heap allocation; such an
+// iterator must not be passed to LLIterator_Free().
 //
 // If you use a LinkedList*() function to mutate a linked list, any iterators
 // you have on that list become undefined (ie, dangerous to use; arbitrary
 // memory corruption can occur). Thus, you should only use LLIterator*()
 // functions in between the manufacturing and freeing of an iterator.
-typedef struct ll_iter LLIterator;  // same trick to hide implementation.
+//
+// Unlike LinkedList, the iterator's structure is defined here so that
+// customers can declare one without allocating it.  Its fields are private:
+// customers should only touch an LLIterator through the LLIterator*()
+// functions.
+typedef struct ll_iter {
+  LinkedList      *list;       // the list we're for
+  struct ll_node  *node;       // the node we are at, or NULL if broken
+  Allocator        allocator;  // what LLIterator_Allocate allocated it with
+  bool             allocated;  // false if set up by LLIterator_Init
+} LLIterator;
 
 // Manufacture an iterator for the list.  Caller is responsible for
 // eventually calling LLIterator_Free to free memory associated with
@@ -155,8 +219,19 @@ typedef struct ll_iter LLIterator;  // same trick to hide implementation.
 //   the list cannot be iterated through (eg, empty).
 LLIterator* LLIterator_Allocate(LinkedList *list);
 
+// Set up a caller-owned iterator for the list.  Afterwards iter behaves
+// just like one returned by LLIterator_Allocate, except that it is the
+// caller's memory and must not be passed to LLIterator_Free (which checks
+// for, and aborts on, such an iterator).
+//
+// Arguments:
+// - iter: the iterator to set up.
+// - list: the list to iterate over.  iter starts at its head, and so may
+//   be invalid or "past the end" if the list is empty.
+void LLIterator_Init(LLIterator *iter, LinkedList *list);
+
 // When you're done with an iterator, you must free it by calling this
-// function.
+// function.  It may be freed before or after its list.
 //
 // Arguments:
 // - iter: the iterator to free. Don't use it after freeing it.
@@ -12,7 +12,8 @@
 #ifndef HW1_LINKEDLIST_PRIV_H_
 #define HW1_LINKEDLIST_PRIV_H_
 
-#include "./LinkedList.h"  // for LinkedList and LLIterator
+#include "./LinkedList.h"  // for LinkedList, LLIterator, and LLIterator_Init
+#include "./Slab.h"        // for Slab
 
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 // Internal structures and helper functions for our LinkedList implementation.
@@ -40,21 +41,18 @@ typedef struct ll_node {
 //
 // We provided a struct declaration (but not definition) in LinkedList.h;
 // this is the associated definition.  This struct contains metadata
-// about the linked list.
+// about the linked list.  Its nodes are allocated from its own slab, so
+// they sit together in memory.
 typedef struct ll {
   int               num_elements;  //  # elements in the list
   LinkedListNode   *head;  // head of linked list, or NULL if empty
   LinkedListNode   *tail;  // tail of linked list, or NULL if empty
+  Slab              node_slab;  // where the list's nodes come from
+  Allocator         allocator;  // where everything else comes from
 } LinkedList;
 
-// A linked list iterator.
-//
-// We expose the struct declaration in LinkedList.h, but not the definition,
-// similar to what we did above for the linked list itself.
-typedef struct ll_iter {
-  LinkedList       *list;  // the list we're for
-  LinkedListNode   *node;  // the node we are at, or NULL if broken
-} LLIterator;
+// A linked list iterator, LLIterator, is defined in LinkedList.h so that
+// customers can declare iterators without allocating them.
 
 
 // Remove an element from the tail of the linked list.
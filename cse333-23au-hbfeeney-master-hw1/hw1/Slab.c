@@ -0,0 +1,146 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "CSE333.h"
+#include "Slab.h"
+
+// Pages start with a single object, so that a short list or small table
+// holds no more nodes than it has used, and double in capacity up to a cap
+// of about 64KiB.  Programs with many short lists pay one page header per
+// doubling rather than a mostly empty page each.
+#define SLAB_FIRST_PAGE_OBJECTS 1
+#define SLAB_MAX_PAGE_BYTES     (64 * 1024)
+
+// Allocates a new page of capacity objects and makes it the page that
+// Slab_Alloc carves new objects from.
+static void AddPage(Slab *slab, size_t capacity) {
+  // Whatever is left of the old page goes onto the free list, so that no
+  // objects are stranded.
+  while (slab->bump < slab->bump_end) {
+    Slab_Free(slab, slab->bump);
+    slab->bump += slab->object_size;
+  }
+
+  size_t page_size = sizeof(SlabPage) + capacity * slab->object_size;
+  SlabPage *page;
+  if (slab->arena != NULL) {
+    page = (SlabPage *) Arena_Alloc(slab->arena, page_size);
+  } else {
+    page = (SlabPage *) Allocator_Alloc(&slab->allocator, page_size);
+  }
+  page->capacity = capacity;
+  page->next = slab->pages;
+  slab->num_bytes += page_size;
+  slab->pages = page;
+  slab->bump = (char *) (page + 1);
+  slab->bump_end = slab->bump + capacity * slab->object_size;
+}
+
+// Sets up an empty slab, leaving its allocator alone.
+static void Reset(Slab *slab, size_t object_size, Arena *arena) {
+  Verify333(object_size > 0);
+
+  // Every object must be able to hold the free list link, and stay
+  // pointer-aligned when packed back to back.
+  if (object_size < sizeof(void *)) {
+    object_size = sizeof(void *);
+  }
+  object_size = (object_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+  slab->object_size = object_size;
+  slab->next_capacity = SLAB_FIRST_PAGE_OBJECTS;
+  slab->pages = NULL;
+  slab->bump = NULL;
+  slab->bump_end = NULL;
+  slab->free_list = NULL;
+  slab->num_free = 0;
+  slab->num_bytes = 0;
+  slab->arena = arena;
+}
+
+void Slab_Init(Slab *slab, size_t object_size, const Allocator *allocator) {
+  Verify333(slab != NULL);
+  Allocator_Init(&slab->allocator, allocator);
+  Reset(slab, object_size, NULL);
+}
+
+void Slab_InitInArena(Slab *slab, size_t object_size, Arena *arena) {
+  Verify333(slab != NULL);
+  Verify333(arena != NULL);
+  Allocator_Init(&slab->allocator, NULL);
+  Reset(slab, object_size, arena);
+}
+
+void Slab_Release(Slab *slab) {
+  Verify333(slab != NULL);
+
+  SlabPage *page = slab->pages;
+  while (slab->arena == NULL && page != NULL) {
+    SlabPage *next = page->next;
+    Allocator_Free(&slab->allocator, page,
+                   sizeof(SlabPage) + page->capacity * slab->object_size);
+    page = next;
+  }
+  Reset(slab, slab->object_size, slab->arena);
+}
+
+void* Slab_Alloc(Slab *slab) {
+  Verify333(slab != NULL);
+
+  // Reuse the most recently freed object, if there is one.
+  if (slab->free_list != NULL) {
+    void *object = slab->free_list;
+    slab->free_list = *(void **) object;
+    slab->num_free--;
+    return object;
+  }
+
+  // Otherwise carve the next object out of the newest page, starting a
+  // new page if that one is used up.
+  if (slab->bump == slab->bump_end) {
+    AddPage(slab, slab->next_capacity);
+    if (slab->next_capacity * 2 * slab->object_size <= SLAB_MAX_PAGE_BYTES) {
+      slab->next_capacity *= 2;
+    }
+  }
+  void *object = slab->bump;
+  slab->bump += slab->object_size;
+  return object;
+}
+
+void Slab_Free(Slab *slab, void *object) {
+  Verify333(slab != NULL);
+  Verify333(object != NULL);
+
+  *(void **) object = slab->free_list;
+  slab->free_list = object;
+  slab->num_free++;
+}
+
+void Slab_Reserve(Slab *slab, size_t num_objects) {
+  Verify333(slab != NULL);
+
+  size_t available =
+      slab->num_free + (slab->bump_end - slab->bump) / slab->object_size;
+  if (available < num_objects) {
+    // The free list is used first, so the new page's objects are handed
+    // out after it's empty: contiguously and in order.
+    AddPage(slab, num_objects - available);
+  }
+}
+
+size_t Slab_NumBytes(const Slab *slab) {
+  Verify333(slab != NULL);
+  return slab->num_bytes;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#ifndef HW1_SLAB_H_
+#define HW1_SLAB_H_
+
+#include <stddef.h>  // for size_t
+
+#include "./Allocator.h"  // for Allocator
+#include "./Arena.h"      // for Arena
+
+///////////////////////////////////////////////////////////////////////////////
+// A Slab is a pool of fixed-size objects: a single size class.
+//
+// LinkedList and HashTable each keep a Slab for their nodes.  Objects are
+// carved out of large pages, one after another, so there's no per-object
+// malloc header and the nodes of one list or table sit packed together in
+// memory rather than scattered across the heap.  Freed objects go onto the
+// slab's free list and are handed out again (most recently freed first,
+// while they're still warm in the cache).
+//
+// Pages are only returned to the system by Slab_Release, so a Slab's
+// footprint is its peak number of live objects.  Pages come from an
+// Allocator, or from an Arena, in which case they're returned when the
+// arena is.
+//
+// Unlike LinkedList and HashTable, the Slab structure is defined here so
+// that it can be embedded directly in its owner.  Its fields are private
+// to Slab.c.
+
+// A page of objects.  The objects follow the header in memory.
+typedef struct slab_page {
+  struct slab_page *next;      // the next (older) page, or NULL
+  size_t            capacity;  // # of objects in this page
+} SlabPage;
+
+typedef struct slab {
+  size_t    object_size;   // bytes per object, rounded up for alignment
+  size_t    next_capacity; // # of objects to put in the next page
+  SlabPage *pages;         // every page, newest first
+  char     *bump;          // next never-used object in the newest page
+  char     *bump_end;      // end of the newest page
+  void     *free_list;     // freed objects, linked through their first word
+  size_t    num_free;      // # of objects on free_list
+  size_t    num_bytes;     // total size of pages, headers included
+  Arena    *arena;         // where pages come from, or NULL
+  Allocator allocator;     // where pages come from if arena is NULL
+} Slab;
+
+// Set up an empty slab for objects of object_size bytes.  No memory is
+// allocated until the first Slab_Alloc.
+//
+// Arguments:
+// - slab: the slab to initialize.
+// - object_size: the size of each object (> 0).
+// - allocator: where to allocate pages from, or NULL for malloc and free.
+void Slab_Init(Slab *slab, size_t object_size, const Allocator *allocator);
+
+// Like Slab_Init, but the slab's pages are allocated from arena, which
+// must outlive the slab.
+//
+// Arguments:
+// - slab: the slab to initialize.
+// - object_size: the size of each object (> 0).
+// - arena: the arena to allocate pages from.
+void Slab_InitInArena(Slab *slab, size_t object_size, Arena *arena);
+
+// Release every page of a slab, and so every object allocated from it,
+// whether or not it was freed.  The slab is left empty and may be reused.
+// (Pages from an arena stay allocated until the arena is released.)
+//
+// Arguments:
+// - slab: the slab to release.
+void Slab_Release(Slab *slab);
+
+// Allocate an object from a slab.
+//
+// Arguments:
+// - slab: the slab to allocate from.
+//
+// Returns:
+// - an uninitialized object of the slab's object size (never NULL).
+void* Slab_Alloc(Slab *slab);
+
+// Return an object to the slab it was allocated from, for reuse.
+//
+// Arguments:
+// - slab: the slab the object came from.
+// - object: the object to free.  Don't use it after freeing it.
+void Slab_Free(Slab *slab, void *object);
+
+// Make sure a slab can hand out num_objects more objects without
+// allocating, by allocating one page for whatever is missing.  The objects
+// from that page are contiguous and handed out in address order.
+//
+// Arguments:
+// - slab: the slab to reserve objects in.
+// - num_objects: the number of objects to reserve (>= 0).
+void Slab_Reserve(Slab *slab, size_t num_objects);
+
+// Return the number of bytes a slab holds in pages, whether its objects are
+// in use or not.  This is O(1).
+//
+// Arguments:
+// - slab: the slab to query.
+size_t Slab_NumBytes(const Slab *slab);
+
+#endif  // HW1_SLAB_H_
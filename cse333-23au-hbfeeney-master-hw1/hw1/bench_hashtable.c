@@ -0,0 +1,369 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+// for getopt
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CSE333.h"
+#include "HashTable.h"
+#include "bench_util.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// A throughput benchmark for HashTable.
+//
+// For each table size n it builds a table with n inserts, looks up present
+// and absent keys, scans the table with an HTIterator and removes every
+// key, timing each phase.  The inserts and lookups both draw their keys
+// from the distribution, so under uniform and zipf some inserts repeat a
+// key and replace its value; any keys the draw missed are then added,
+// untimed, so that the later phases see all n.  Small sizes are repeated
+// until each phase has done at least -o operations.  Results are printed
+// as JSON.
+//
+// Usage: bench_hashtable [-n size]... [-d seq|uniform|zipf] [-e flat]
+//                        [-x modulo|mask|fastrange] [-i] [-a]
+//                        [-l max_load] [-g growth] [-s min_load]
+//                        [-b buckets] [-o min_ops] [-p]
+//
+// - -n: a table size, such as 1K or 100M; may be repeated.  The default
+//   sweep is 1K, 10K, 100K, 1M and 10M.  100M is left out of it because
+//   it takes several GiB (three 800MB key arrays plus the table), more
+//   than many machines have free; ask for it with -n 100M.
+// - -d: the key distribution (see BenchDist_t); default seq.
+// - -e flat: use the flat engine.
+// - -x: the index mode (see HTIndexMode_t); default modulo.
+// - -i, -a: use incremental resizing, arena mode.
+// - -l, -g, -s: the max load, growth and min load factors.
+// - -b: the number of buckets to allocate the table with; default 16.
+// - -o: the minimum number of operations per phase; default 1M.
+// - -p: count hardware events (see BenchPerf) over each phase, and report
+//   them per operation.  If no counter is available, says so on stderr
+//   and carries on without them.
+//
+// "make bench" also builds bench_hashtable_latency, which is the same
+// program over a library built with HT_ENABLE_LATENCY.  It adds p50, p99,
+// p99.9 and max latencies to each result, plus a "resize" result for the
+// index rebuilds done along the way, at the cost of a couple of clock
+// reads per operation in the throughput numbers.
+
+// The sizes swept when no -n is given.
+static const uint64_t kDefaultSizes[] = {
+  1000, 10000, 100000, 1000000, 10000000
+};
+
+#define MAX_SIZES 32
+
+// The phases whose latencies are reported.
+enum {
+  PHASE_INSERT,
+  PHASE_RESIZE,
+  PHASE_FIND_HIT,
+  PHASE_FIND_MISS,
+  PHASE_ITERATE,
+  PHASE_REMOVE,
+  NUM_PHASES
+};
+
+// Whether the library records latencies; see HashTable_LatencySnapshot.
+static bool latency_enabled;
+
+// The hardware counters, or NULL if they're off; see -p.
+static BenchPerf *perf;
+
+// Adds table's latency histogram for op to *acc.
+static void TakeLatency(HashTable *table, HTLatencyOp_t op,
+                        HTLatencyHistogram *acc) {
+  HTLatencyHistogram histogram;
+  latency_enabled = HashTable_LatencySnapshot(table, op, &histogram);
+  HTLatency_Merge(acc, &histogram);
+}
+
+// Reports a phase, with its latency percentiles if they're being kept and
+// its hardware counters if they're on.
+static void Report(BenchReport *report, const char *op, uint64_t n,
+                   BenchDist_t dist, uint64_t num_ops, uint64_t nanos,
+                   const HTLatencyHistogram *histogram,
+                   const BenchCounters *counters) {
+  BenchLatency latency;
+  latency.p50 = HTLatency_Percentile(histogram, 50.0);
+  latency.p99 = HTLatency_Percentile(histogram, 99.0);
+  latency.p999 = HTLatency_Percentile(histogram, 99.9);
+  latency.max = histogram->max_ns;
+  Bench_Result(report, op, n, dist, num_ops, nanos,
+               latency_enabled ? &latency : NULL,
+               perf != NULL ? counters : NULL);
+}
+
+// Runs every phase on tables of n keys, and reports the results.
+static void BenchSize(BenchReport *report, const HTOptions *options,
+                      int num_buckets, BenchDist_t dist, uint64_t n,
+                      uint64_t min_ops) {
+  HTKey_t *keys = (HTKey_t *) malloc(n * sizeof(HTKey_t));
+  HTKey_t *lookups = (HTKey_t *) malloc(n * sizeof(HTKey_t));
+  uint64_t *indexes = (uint64_t *) malloc(n * sizeof(uint64_t));
+  Verify333(keys != NULL && lookups != NULL && indexes != NULL);
+
+  BenchRng rng;
+  BenchZipf zipf;
+  Bench_RngInit(&rng, n);
+  if (dist == BENCH_ZIPF) {
+    Bench_ZipfInit(&zipf, n, 0.99);
+  }
+  for (uint64_t i = 0; i < n; i++) {
+    keys[i] = Bench_Key(dist, i);
+  }
+
+  // The histograms are big, so they aren't kept on the stack.
+  HTLatencyHistogram *latency = (HTLatencyHistogram *)
+      calloc(NUM_PHASES, sizeof(HTLatencyHistogram));
+  Verify333(latency != NULL);
+  BenchCounters *counters = (BenchCounters *)
+      calloc(NUM_PHASES, sizeof(BenchCounters));
+  Verify333(counters != NULL);
+
+  uint64_t reps = (min_ops + n - 1) / n;
+  uint64_t insert_ns = 0, hit_ns = 0, miss_ns = 0, scan_ns = 0;
+  uint64_t remove_ns = 0;
+  for (uint64_t rep = 0; rep < reps; rep++) {
+    HashTable *table = HashTable_AllocateWithOptions(num_buckets, options);
+    HTKeyValue_t kv, oldkv;
+    uint64_t count = 0;
+    uint64_t start;
+
+    // Build the table, growing it all the way from num_buckets, with keys
+    // in the distribution's order.
+    Bench_FillIndexes(dist, n, indexes, n, &rng, &zipf);
+    for (uint64_t i = 0; i < n; i++) {
+      lookups[i] = keys[indexes[i]];
+    }
+    kv.value = NULL;
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      kv.key = lookups[i];
+      count += HashTable_Insert(table, kv, &oldkv);
+    }
+    insert_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_INSERT]);
+    Verify333(dist != BENCH_SEQUENTIAL || count == 0);
+    TakeLatency(table, HT_LATENCY_RESIZE, &latency[PHASE_RESIZE]);
+    TakeLatency(table, HT_LATENCY_INSERT, &latency[PHASE_INSERT]);
+
+    // Add whatever keys the draw missed.
+    for (uint64_t i = 0; i < n; i++) {
+      kv.key = keys[i];
+      HashTable_Insert(table, kv, &oldkv);
+    }
+    Verify333((uint64_t) HashTable_NumElements(table) == n);
+    HashTable_LatencyReset(table);
+    count = 0;
+
+    // Look up present keys, in the distribution's order.
+    Bench_FillIndexes(dist, n, indexes, n, &rng, &zipf);
+    for (uint64_t i = 0; i < n; i++) {
+      lookups[i] = keys[indexes[i]];
+    }
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      count += HashTable_Find(table, lookups[i], &kv);
+    }
+    hit_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_FIND_HIT]);
+    Verify333(count == n);
+    TakeLatency(table, HT_LATENCY_FIND, &latency[PHASE_FIND_HIT]);
+    HashTable_LatencyReset(table);
+
+    // Look up keys that were never inserted.
+    for (uint64_t i = 0; i < n; i++) {
+      lookups[i] = Bench_Key(dist, n + indexes[i]);
+    }
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      count += HashTable_Find(table, lookups[i], &kv);
+    }
+    miss_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_FIND_MISS]);
+    Verify333(count == n);
+    TakeLatency(table, HT_LATENCY_FIND, &latency[PHASE_FIND_MISS]);
+
+    // Scan the whole table.
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    HTIterator *it = HTIterator_Allocate(table);
+    for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+      HTIterator_Get(it, &kv);
+      count++;
+    }
+    HTIterator_Free(it);
+    scan_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_ITERATE]);
+    Verify333(count == 2 * n);
+
+    // Remove every key, in insertion order.
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      count += HashTable_Remove(table, keys[i], &oldkv);
+    }
+    remove_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_REMOVE]);
+    Verify333(count == 3 * n);
+    TakeLatency(table, HT_LATENCY_RESIZE, &latency[PHASE_RESIZE]);
+    TakeLatency(table, HT_LATENCY_REMOVE, &latency[PHASE_REMOVE]);
+
+    HashTable_Free(table, NULL);
+  }
+
+  uint64_t num_ops = reps * n;
+  Report(report, "insert", n, dist, num_ops, insert_ns,
+         &latency[PHASE_INSERT], &counters[PHASE_INSERT]);
+  Report(report, "find_hit", n, dist, num_ops, hit_ns,
+         &latency[PHASE_FIND_HIT], &counters[PHASE_FIND_HIT]);
+  Report(report, "find_miss", n, dist, num_ops, miss_ns,
+         &latency[PHASE_FIND_MISS], &counters[PHASE_FIND_MISS]);
+  Bench_Result(report, "iterate", n, dist, num_ops, scan_ns, NULL,
+               perf != NULL ? &counters[PHASE_ITERATE] : NULL);
+  Report(report, "remove", n, dist, num_ops, remove_ns,
+         &latency[PHASE_REMOVE], &counters[PHASE_REMOVE]);
+  if (latency_enabled) {
+    // Resizes happen inside the other phases, so they have no counters of
+    // their own.
+    Report(report, "resize", n, dist, latency[PHASE_RESIZE].count,
+           latency[PHASE_RESIZE].total_ns, &latency[PHASE_RESIZE], NULL);
+  }
+  free(latency);
+  free(counters);
+
+  free(keys);
+  free(lookups);
+  free(indexes);
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-n size]... [-d seq|uniform|zipf] [-e flat]\n"
+          "       [-x modulo|mask|fastrange] [-i] [-a] [-l max_load]\n"
+          "       [-g growth] [-s min_load] [-b buckets] [-o min_ops] [-p]\n",
+          program);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  uint64_t sizes[MAX_SIZES];
+  int num_sizes = 0;
+  BenchDist_t dist = BENCH_SEQUENTIAL;
+  int num_buckets = 16;
+  uint64_t min_ops = 1000000;
+  HTOptions options;
+  BenchPerf perf_counters;
+  bool use_counters = false;
+  int opt;
+
+  HTOptions_Init(&options);
+  while ((opt = getopt(argc, argv, "n:d:e:x:iab:l:g:s:o:p")) != -1) {
+    switch (opt) {
+      case 'n':
+        if (num_sizes == MAX_SIZES ||
+            (sizes[num_sizes++] = Bench_ParseSize(optarg)) == 0) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'd':
+        if (!Bench_ParseDist(optarg, &dist)) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'e':
+        if (strcmp(optarg, "flat") == 0) {
+          options.engine = HT_ENGINE_FLAT;
+        } else if (strcmp(optarg, "chained") != 0) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'x':
+        if (!Bench_ParseIndexMode(optarg, &options.index_mode)) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'i':
+        options.incremental_resize = true;
+        break;
+      case 'a':
+        options.arena = true;
+        break;
+      case 'b':
+        num_buckets = atoi(optarg);
+        break;
+      case 'l':
+        options.max_load_factor = atof(optarg);
+        break;
+      case 'g':
+        options.growth_factor = atof(optarg);
+        break;
+      case 's':
+        options.min_load_factor = atof(optarg);
+        break;
+      case 'o':
+        min_ops = Bench_ParseSize(optarg);
+        break;
+      case 'p':
+        use_counters = true;
+        break;
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (optind != argc || num_buckets <= 0 || min_ops == 0) {
+    Usage(argv[0]);
+  }
+  if (num_sizes == 0) {
+    num_sizes = sizeof(kDefaultSizes) / sizeof(kDefaultSizes[0]);
+    memcpy(sizes, kDefaultSizes, sizeof(kDefaultSizes));
+  }
+  if (use_counters) {
+    if (Bench_PerfOpen(&perf_counters)) {
+      perf = &perf_counters;
+    } else {
+      fprintf(stderr, "%s: hardware counters aren't available; "
+              "reporting without them\n", argv[0]);
+    }
+  }
+
+  char config[512];
+  snprintf(config, sizeof(config),
+           "{\"engine\": \"%s\", \"index_mode\": \"%s\", "
+           "\"incremental_resize\": %s, \"arena\": %s, "
+           "\"max_load_factor\": %g, \"growth_factor\": %g, "
+           "\"min_load_factor\": %g, \"initial_buckets\": %d}",
+           options.engine == HT_ENGINE_FLAT ? "flat" : "chained",
+           Bench_IndexModeName(options.index_mode),
+           options.incremental_resize ? "true" : "false",
+           options.arena ? "true" : "false", options.max_load_factor,
+           options.growth_factor, options.min_load_factor, num_buckets);
+
+  BenchReport report;
+  Bench_BeginReport(&report, "hashtable", config);
+  for (int i = 0; i < num_sizes; i++) {
+    BenchSize(&report, &options, num_buckets, dist, sizes[i], min_ops);
+  }
+  Bench_EndReport(&report);
+  if (perf != NULL) {
+    Bench_PerfClose(perf);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+// for getopt
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CSE333.h"
+#include "LinkedList.h"
+#include "bench_util.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// A throughput benchmark for LinkedList.
+//
+// For each list size it pushes that many payloads, pops them all, appends
+// them and sorts the list, timing each phase.  The distribution decides
+// the payloads, and so how much work the sort has to do.  Small sizes are
+// repeated until each phase has done at least -o operations.  Results are
+// printed as JSON.
+//
+// LinkedList_Sort is a bubble sort, so it's only timed for lists of up to
+// -s elements.
+//
+// Usage: bench_linkedlist [-n size]... [-d seq|uniform|zipf] [-s max]
+//                         [-o min_ops] [-p]
+//
+// - -n: a list size, such as 1K or 10M; may be repeated.  The default
+//   sweep is 1K, 10K, 100K, 1M and 10M.
+// - -d: the payload distribution (see BenchDist_t); default seq.
+// - -s: the largest list to sort; default 10K.
+// - -o: the minimum number of operations per phase; default 1M.
+// - -p: count hardware events (see BenchPerf) over each phase, and report
+//   them per operation, as bench_hashtable -p does.
+
+// The sizes swept when no -n is given.
+static const uint64_t kDefaultSizes[] = {
+  1000, 10000, 100000, 1000000, 10000000
+};
+
+#define MAX_SIZES 32
+
+// The phases, for their hardware counters.
+enum {
+  PHASE_PUSH,
+  PHASE_POP,
+  PHASE_APPEND,
+  PHASE_SORT,
+  NUM_PHASES
+};
+
+// The hardware counters, or NULL if they're off; see -p.
+static BenchPerf *perf;
+
+// Orders payloads as unsigned numbers.
+static int ComparePayloads(LLPayload_t p1, LLPayload_t p2) {
+  uintptr_t a = (uintptr_t) p1, b = (uintptr_t) p2;
+  return a < b ? -1 : a > b;
+}
+
+// Does nothing; the payloads are just numbers.
+static void NoOpFree(LLPayload_t payload) { }
+
+// Runs every phase on lists of n payloads, and reports the results.
+static void BenchSize(BenchReport *report, BenchDist_t dist, uint64_t n,
+                      uint64_t max_sort, uint64_t min_ops) {
+  LLPayload_t *payloads = (LLPayload_t *) malloc(n * sizeof(LLPayload_t));
+  uint64_t *indexes = (uint64_t *) malloc(n * sizeof(uint64_t));
+  Verify333(payloads != NULL && indexes != NULL);
+
+  // Payloads are the keys the distribution visits, in the order it visits
+  // them: sorted for seq, and with repeats of the hot keys for zipf.
+  BenchRng rng;
+  BenchZipf zipf;
+  Bench_RngInit(&rng, n);
+  if (dist == BENCH_ZIPF) {
+    Bench_ZipfInit(&zipf, n, 0.99);
+  }
+  Bench_FillIndexes(dist, n, indexes, n, &rng, &zipf);
+  for (uint64_t i = 0; i < n; i++) {
+    payloads[i] = (LLPayload_t) (uintptr_t) Bench_Key(dist, indexes[i]);
+  }
+
+  uint64_t reps = (min_ops + n - 1) / n;
+  uint64_t push_ns = 0, pop_ns = 0, append_ns = 0, sort_ns = 0;
+  BenchCounters counters[NUM_PHASES];
+  memset(counters, 0, sizeof(counters));
+  for (uint64_t rep = 0; rep < reps; rep++) {
+    LinkedList *list = LinkedList_Allocate();
+    LLPayload_t payload;
+    uint64_t count = 0;
+    uint64_t start;
+
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      LinkedList_Push(list, payloads[i]);
+    }
+    push_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_PUSH]);
+
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      count += LinkedList_Pop(list, &payload);
+    }
+    pop_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_POP]);
+    Verify333(count == n);
+
+    Bench_PerfStart(perf);
+    start = Bench_Now();
+    for (uint64_t i = 0; i < n; i++) {
+      LinkedList_Append(list, payloads[i]);
+    }
+    append_ns += Bench_Now() - start;
+    Bench_PerfStop(perf, &counters[PHASE_APPEND]);
+
+    // One sort per list is plenty: it's O(n^2).
+    if (n <= max_sort && rep == 0) {
+      Bench_PerfStart(perf);
+      start = Bench_Now();
+      LinkedList_Sort(list, true, &ComparePayloads);
+      sort_ns += Bench_Now() - start;
+      Bench_PerfStop(perf, &counters[PHASE_SORT]);
+    }
+
+    LinkedList_Free(list, &NoOpFree);
+  }
+
+  uint64_t num_ops = reps * n;
+  bool use_counters = perf != NULL;
+  Bench_Result(report, "push", n, dist, num_ops, push_ns, NULL,
+               use_counters ? &counters[PHASE_PUSH] : NULL);
+  Bench_Result(report, "pop", n, dist, num_ops, pop_ns, NULL,
+               use_counters ? &counters[PHASE_POP] : NULL);
+  Bench_Result(report, "append", n, dist, num_ops, append_ns, NULL,
+               use_counters ? &counters[PHASE_APPEND] : NULL);
+  if (n <= max_sort) {
+    // Reported per element sorted.
+    Bench_Result(report, "sort", n, dist, n, sort_ns, NULL,
+                 use_counters ? &counters[PHASE_SORT] : NULL);
+  }
+
+  free(payloads);
+  free(indexes);
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-n size]... [-d seq|uniform|zipf] [-s max_sort]\n"
+          "       [-o min_ops] [-p]\n", program);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  uint64_t sizes[MAX_SIZES];
+  int num_sizes = 0;
+  BenchDist_t dist = BENCH_SEQUENTIAL;
+  uint64_t max_sort = 10000;
+  uint64_t min_ops = 1000000;
+  BenchPerf perf_counters;
+  bool use_counters = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:d:s:o:p")) != -1) {
+    switch (opt) {
+      case 'n':
+        if (num_sizes == MAX_SIZES ||
+            (sizes[num_sizes++] = Bench_ParseSize(optarg)) == 0) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'd':
+        if (!Bench_ParseDist(optarg, &dist)) {
+          Usage(argv[0]);
+        }
+        break;
+      case 's':
+        max_sort = Bench_ParseSize(optarg);
+        break;
+      case 'o':
+        min_ops = Bench_ParseSize(optarg);
+        break;
+      case 'p':
+        use_counters = true;
+        break;
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (optind != argc || min_ops == 0) {
+    Usage(argv[0]);
+  }
+  if (num_sizes == 0) {
+    num_sizes = sizeof(kDefaultSizes) / sizeof(kDefaultSizes[0]);
+    memcpy(sizes, kDefaultSizes, sizeof(kDefaultSizes));
+  }
+  if (use_counters) {
+    if (Bench_PerfOpen(&perf_counters)) {
+      perf = &perf_counters;
+    } else {
+      fprintf(stderr, "%s: hardware counters aren't available; "
+              "reporting without them\n", argv[0]);
+    }
+  }
+
+  char config[128];
+  snprintf(config, sizeof(config), "{\"max_sort\": %llu}",
+           (unsigned long long) max_sort);
+
+  BenchReport report;
+  Bench_BeginReport(&report, "linkedlist", config);
+  for (int i = 0; i < num_sizes; i++) {
+    BenchSize(&report, dist, sizes[i], max_sort, min_ops);
+  }
+  Bench_EndReport(&report);
+  if (perf != NULL) {
+    Bench_PerfClose(perf);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,326 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+// for clock_gettime and getrusage, and syscall
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "CSE333.h"
+#include "bench_util.h"
+
+// The names of the index modes, indexed by HTIndexMode_t.
+static const char *kIndexModeNames[] = { "modulo", "mask", "fastrange" };
+
+#define NUM_INDEX_MODES (sizeof(kIndexModeNames) / sizeof(kIndexModeNames[0]))
+
+// Scatters i over all 64-bit numbers.  This is the splitmix64 finalizer,
+// which is a bijection, so distinct inputs give distinct keys.
+static uint64_t Mix(uint64_t i) {
+  i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+  return i ^ (i >> 31);
+}
+
+// The names the counters are reported under, in BenchPerf's order.
+static const char *kCounterNames[BENCH_NUM_COUNTERS] = {
+  "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses",
+  "branch_misses"
+};
+
+#ifdef __linux__
+// Returns the perf_event_attr config of a read-miss cache event.
+static uint64_t CacheMiss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Opens one counter, disabled, for this thread in user space.  Returns -1
+// if it isn't available.
+static int OpenCounter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif  // __linux__
+
+// Returns a pseudo-random double in [0, 1).
+static double RandUnit(BenchRng *rng) {
+  return (Bench_Rand(rng) >> 11) * (1.0 / (UINT64_C(1) << 53));
+}
+
+bool Bench_ParseDist(const char *name, BenchDist_t *dist) {
+  if (strcmp(name, "seq") == 0) {
+    *dist = BENCH_SEQUENTIAL;
+  } else if (strcmp(name, "uniform") == 0) {
+    *dist = BENCH_UNIFORM;
+  } else if (strcmp(name, "zipf") == 0) {
+    *dist = BENCH_ZIPF;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* Bench_DistName(BenchDist_t dist) {
+  switch (dist) {
+    case BENCH_SEQUENTIAL:
+      return "seq";
+    case BENCH_UNIFORM:
+      return "uniform";
+    default:
+      return "zipf";
+  }
+}
+
+bool Bench_ParseIndexMode(const char *name, HTIndexMode_t *mode) {
+  for (size_t i = 0; i < NUM_INDEX_MODES; i++) {
+    if (strcmp(name, kIndexModeNames[i]) == 0) {
+      *mode = (HTIndexMode_t) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* Bench_IndexModeName(HTIndexMode_t mode) {
+  Verify333((size_t) mode < NUM_INDEX_MODES);
+  return kIndexModeNames[mode];
+}
+
+uint64_t Bench_ParseSize(const char *str) {
+  char *end;
+  unsigned long long size = strtoull(str, &end, 10);
+
+  if (end == str) {
+    return 0;
+  }
+  if (*end == 'K' || *end == 'k') {
+    size *= 1000;
+    end++;
+  } else if (*end == 'M' || *end == 'm') {
+    size *= 1000000;
+    end++;
+  }
+  return *end == '\0' ? size : 0;
+}
+
+uint64_t Bench_Now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+long Bench_PeakRSSKiB(void) {
+  struct rusage usage;
+  Verify333(getrusage(RUSAGE_SELF, &usage) == 0);
+  return usage.ru_maxrss;  // already in KiB on Linux
+}
+
+bool Bench_PerfOpen(BenchPerf *perf) {
+  bool any = false;
+
+  for (int i = 0; i < BENCH_NUM_COUNTERS; i++) {
+    perf->fds[i] = -1;
+  }
+#ifdef __linux__
+  perf->fds[0] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  perf->fds[1] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  perf->fds[2] = OpenCounter(PERF_TYPE_HW_CACHE,
+                             CacheMiss(PERF_COUNT_HW_CACHE_L1D));
+  perf->fds[3] = OpenCounter(PERF_TYPE_HW_CACHE,
+                             CacheMiss(PERF_COUNT_HW_CACHE_LL));
+  perf->fds[4] = OpenCounter(PERF_TYPE_HW_CACHE,
+                             CacheMiss(PERF_COUNT_HW_CACHE_DTLB));
+  perf->fds[5] = OpenCounter(PERF_TYPE_HARDWARE,
+                             PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+  for (int i = 0; i < BENCH_NUM_COUNTERS; i++) {
+    any |= perf->fds[i] >= 0;
+  }
+  return any;
+}
+
+void Bench_PerfClose(BenchPerf *perf) {
+  for (int i = 0; i < BENCH_NUM_COUNTERS; i++) {
+    if (perf->fds[i] >= 0) {
+      close(perf->fds[i]);
+      perf->fds[i] = -1;
+    }
+  }
+}
+
+void Bench_PerfStart(BenchPerf *perf) {
+#ifdef __linux__
+  for (int i = 0; perf != NULL && i < BENCH_NUM_COUNTERS; i++) {
+    if (perf->fds[i] >= 0) {
+      ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+void Bench_PerfStop(BenchPerf *perf, BenchCounters *counters) {
+#ifdef __linux__
+  if (perf == NULL) {
+    return;
+  }
+  for (int i = 0; i < BENCH_NUM_COUNTERS; i++) {
+    if (perf->fds[i] >= 0) {
+      ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  for (int i = 0; i < BENCH_NUM_COUNTERS; i++) {
+    uint64_t data[3];  // value, time enabled, time running
+
+    if (perf->fds[i] < 0 ||
+        read(perf->fds[i], data, sizeof(data)) != sizeof(data)) {
+      continue;
+    }
+    if (data[2] > 0 && data[2] < data[1]) {
+      data[0] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+    }
+    counters->valid[i] = true;
+    counters->values[i] += data[0];
+  }
+#endif
+}
+
+void Bench_RngInit(BenchRng *rng, uint64_t seed) {
+  rng->state = seed;
+}
+
+uint64_t Bench_Rand(BenchRng *rng) {
+  rng->state += 0x9e3779b97f4a7c15ULL;
+  return Mix(rng->state);
+}
+
+void Bench_ZipfInit(BenchZipf *zipf, uint64_t n, double theta) {
+  double zeta2 = 1.0 + pow(0.5, theta);
+
+  Verify333(n > 0);
+  Verify333(theta > 0.0 && theta < 1.0);
+
+  // zetan is the generalized harmonic number of n, which is what makes
+  // setup O(n).
+  zipf->zetan = 0.0;
+  for (uint64_t i = 1; i <= n; i++) {
+    zipf->zetan += 1.0 / pow((double) i, theta);
+  }
+  zipf->n = n;
+  zipf->theta = theta;
+  zipf->alpha = 1.0 / (1.0 - theta);
+  zipf->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+  zipf->half_pow_theta = pow(0.5, theta);
+}
+
+uint64_t Bench_ZipfNext(const BenchZipf *zipf, BenchRng *rng) {
+  double u = RandUnit(rng);
+  double uz = u * zipf->zetan;
+
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < 1.0 + zipf->half_pow_theta) {
+    return 1;
+  }
+  uint64_t i = (uint64_t) (zipf->n *
+                           pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+  return i < zipf->n ? i : zipf->n - 1;
+}
+
+uint64_t Bench_Key(BenchDist_t dist, uint64_t i) {
+  return dist == BENCH_SEQUENTIAL ? i : Mix(i);
+}
+
+void Bench_FillIndexes(BenchDist_t dist, uint64_t n, uint64_t *indexes,
+                       size_t count, BenchRng *rng, const BenchZipf *zipf) {
+  for (size_t i = 0; i < count; i++) {
+    switch (dist) {
+      case BENCH_SEQUENTIAL:
+        indexes[i] = i % n;
+        break;
+      case BENCH_UNIFORM:
+        indexes[i] = Bench_Rand(rng) % n;
+        break;
+      default:
+        indexes[i] = Bench_ZipfNext(zipf, rng);
+        break;
+    }
+  }
+}
+
+void Bench_BeginReport(BenchReport *report, const char *benchmark,
+                       const char *config) {
+  printf("{\n  \"benchmark\": \"%s\",\n  \"config\": %s,\n  \"results\": [",
+         benchmark, config);
+  report->first_result = true;
+}
+
+void Bench_Result(BenchReport *report, const char *op, uint64_t size,
+                  BenchDist_t dist, uint64_t num_ops, uint64_t nanos,
+                  const BenchLatency *latency,
+                  const BenchCounters *counters) {
+  double ns_per_op = num_ops > 0 ? (double) nanos / num_ops : 0.0;
+  double ops_per_sec = nanos > 0 ? num_ops * 1e9 / nanos : 0.0;
+
+  printf("%s\n    {\"op\": \"%s\", \"size\": %llu, \"dist\": \"%s\", "
+         "\"ops\": %llu, \"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, "
+         "\"peak_rss_kib\": %ld",
+         report->first_result ? "" : ",", op, (unsigned long long) size,
+         Bench_DistName(dist), (unsigned long long) num_ops, ns_per_op,
+         ops_per_sec, Bench_PeakRSSKiB());
+  if (latency != NULL) {
+    printf(", \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+           "\"max_ns\": %llu", (unsigned long long) latency->p50,
+           (unsigned long long) latency->p99,
+           (unsigned long long) latency->p999,
+           (unsigned long long) latency->max);
+  }
+  for (int i = 0; counters != NULL && i < BENCH_NUM_COUNTERS; i++) {
+    if (counters->valid[i]) {
+      printf(", \"%s_per_op\": %.3f", kCounterNames[i],
+             num_ops > 0 ? (double) counters->values[i] / num_ops : 0.0);
+    }
+  }
+  printf("}");
+  report->first_result = false;
+
+  // Flush as we go, so a long sweep's results show up (and survive being
+  // killed) as they're measured.
+  fflush(stdout);
+}
+
+void Bench_EndReport(BenchReport *report) {
+  printf("\n  ]\n}\n");
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#ifndef HW1_BENCH_UTIL_H_
+#define HW1_BENCH_UTIL_H_
+
+#include <stdbool.h>  // for bool type (true, false)
+#include <stddef.h>   // for size_t
+#include <stdint.h>   // for uint64_t, etc.
+
+#include "HashTable.h"  // for HTIndexMode_t
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers shared by the benchmark programs: key distributions, index mode
+// names, timing, hardware counters, and JSON reporting.
+
+// How a benchmark picks its keys.  Each size n has n distinct keys, and
+// the distribution decides both what they are and in what order inserts
+// and lookups visit them:
+// - BENCH_SEQUENTIAL: keys 0..n-1, visited in order.
+// - BENCH_UNIFORM: n scattered 64-bit keys, visited uniformly at random.
+// - BENCH_ZIPF: the same keys, visited with Zipfian skew (theta 0.99), so
+//   a few hot keys take most of the lookups.
+typedef enum {
+  BENCH_SEQUENTIAL,
+  BENCH_UNIFORM,
+  BENCH_ZIPF
+} BenchDist_t;
+
+// A small, fast pseudo-random generator (splitmix64).
+typedef struct {
+  uint64_t state;
+} BenchRng;
+
+// Draws from a Zipfian distribution over 0..n-1 (0 is hottest), using the
+// method of Gray et al., "Quickly Generating Billion-Record Synthetic
+// Databases": O(n) to set up, O(1) per draw.
+typedef struct {
+  uint64_t n;
+  double   theta;
+  double   zetan;
+  double   alpha;
+  double   eta;
+  double   half_pow_theta;
+} BenchZipf;
+
+// Latency percentiles to report along with a result, in nanoseconds.
+typedef struct {
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t p999;
+  uint64_t max;
+} BenchLatency;
+
+// The hardware events counted by BenchPerf, in the order they're reported:
+// cycles, instructions, L1D read misses, LLC read misses, dTLB read misses
+// and branch misses.
+#define BENCH_NUM_COUNTERS 6
+
+// Hardware counters (from perf_event_open) for the calling thread, in user
+// space only.  Counters the kernel, CPU or container won't give us are
+// left closed, and simply aren't reported.
+typedef struct {
+  int fds[BENCH_NUM_COUNTERS];  // -1 if the counter isn't available
+} BenchPerf;
+
+// Counts accumulated over one or more BenchPerf measurements.
+typedef struct {
+  bool     valid[BENCH_NUM_COUNTERS];   // was the counter available?
+  uint64_t values[BENCH_NUM_COUNTERS];
+} BenchCounters;
+
+// The results of one benchmark program run, printed as a JSON object.
+typedef struct {
+  bool first_result;  // no result printed yet?
+} BenchReport;
+
+// Parse a distribution name ("seq", "uniform" or "zipf").  Returns false
+// if name isn't one of them.
+bool Bench_ParseDist(const char *name, BenchDist_t *dist);
+
+// Return the name of a distribution, as Bench_ParseDist takes it.
+const char* Bench_DistName(BenchDist_t dist);
+
+// Parse an index mode name ("modulo", "mask" or "fastrange").  Returns
+// false if name isn't one of them.
+bool Bench_ParseIndexMode(const char *name, HTIndexMode_t *mode);
+
+// Return the name of an index mode, as Bench_ParseIndexMode takes it.
+const char* Bench_IndexModeName(HTIndexMode_t mode);
+
+// Parse a size such as "1000", "10K" or "100M".  Returns 0 if str isn't a
+// positive size.
+uint64_t Bench_ParseSize(const char *str);
+
+// Return the current time, in nanoseconds, from a monotonic clock.
+uint64_t Bench_Now(void);
+
+// Return the peak resident set size of this process so far, in KiB.
+long Bench_PeakRSSKiB(void);
+
+// Open the hardware counters.  Returns false, with every counter closed,
+// if none of them is available; perf_event_paranoid or a container's
+// seccomp policy often forbids them.
+bool Bench_PerfOpen(BenchPerf *perf);
+
+// Close the hardware counters.
+void Bench_PerfClose(BenchPerf *perf);
+
+// Start counting from zero.  Does nothing if perf is NULL, so callers can
+// pass NULL when counters are off.
+void Bench_PerfStart(BenchPerf *perf);
+
+// Stop counting, and add the counts since Bench_PerfStart to *counters,
+// which should start out zeroed.  Counts are scaled up if the kernel had
+// to multiplex the counters.  Does nothing if perf is NULL.
+void Bench_PerfStop(BenchPerf *perf, BenchCounters *counters);
+
+// Seed a generator.
+void Bench_RngInit(BenchRng *rng, uint64_t seed);
+
+// Return the next pseudo-random 64-bit number from rng.
+uint64_t Bench_Rand(BenchRng *rng);
+
+// Set up a Zipfian distribution over 0..n-1 with skew theta (0 < theta <
+// 1; higher is more skewed).
+void Bench_ZipfInit(BenchZipf *zipf, uint64_t n, double theta);
+
+// Draw a number from a Zipfian distribution.
+uint64_t Bench_ZipfNext(const BenchZipf *zipf, BenchRng *rng);
+
+// Return key i of the distinct keys of dist.  Every i gives a different
+// key, so keys n, n+1, ... are never among keys 0..n-1.
+uint64_t Bench_Key(BenchDist_t dist, uint64_t i);
+
+// Fill indexes[0..count) with indexes into n keys, in the order dist
+// visits them.
+void Bench_FillIndexes(BenchDist_t dist, uint64_t n, uint64_t *indexes,
+                       size_t count, BenchRng *rng, const BenchZipf *zipf);
+
+// Start a report: print the opening of the JSON object, naming the
+// benchmark, then config (a JSON object, as text) describing the run.
+void Bench_BeginReport(BenchReport *report, const char *benchmark,
+                       const char *config);
+
+// Add a result to a report: num_ops of op took nanos in total, on size
+// elements with keys from dist.  If latency isn't NULL its percentiles
+// are reported too, and if counters isn't NULL its valid counters are,
+// per operation.
+void Bench_Result(BenchReport *report, const char *op, uint64_t size,
+                  BenchDist_t dist, uint64_t num_ops, uint64_t nanos,
+                  const BenchLatency *latency,
+                  const BenchCounters *counters);
+
+// Finish a report, closing the JSON object.
+void Bench_EndReport(BenchReport *report);
+
+#endif  // HW1_BENCH_UTIL_H_
@@ -0,0 +1,305 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+// for getopt
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CSE333.h"
+#include "HashTable.h"
+#include "bench_util.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Replays a trace written by HashTable_StartTrace through HashTable_*, at
+// full speed, and reports throughput and latency.
+//
+// The whole trace is read into memory first, so the file system stays out
+// of the timings.  It's then replayed twice: once untimed but for the
+// total, for throughput, and once timing every call, for latency
+// percentiles per operation.  Each HT_TRACE_BEGIN starts a fresh table
+// with the traced bucket count, so a trace of several tables replays them
+// one after another.  Results are printed as JSON.
+//
+// Usage: replay_hashtable [-e flat] [-x modulo|mask|fastrange] [-i] [-a]
+//                         [-l max_load] [-g growth] [-s min_load] [-v]
+//                         trace
+//
+// - -e flat: use the flat engine.
+// - -x: the index mode (see HTIndexMode_t); default modulo.
+// - -i, -a: use incremental resizing, arena mode.
+// - -l, -g, -s: the max load, growth and min load factors.
+// - -v: give each inserted key a value allocated at its traced size class,
+//   and free values as the original program would have.  Without -v every
+//   value is NULL.  The values' malloc and free are timed along with the
+//   inserts and removes.
+
+// The operations reported on; the index of each is its HTTraceOp_t.
+static const char *kOpNames[] = {
+  NULL, NULL, "insert", "find", "find_or_insert", "remove", "iterate",
+  "reserve", "compact", "free"
+};
+
+#define NUM_OPS (sizeof(kOpNames) / sizeof(kOpNames[0]))
+
+// The replay's view of a trace.
+typedef struct {
+  HTTraceRecord *records;
+  size_t         num_records;
+  uint64_t       counts[NUM_OPS];  // records of each op
+} Trace;
+
+// Whether to allocate values; see -v.
+static bool alloc_values;
+
+static void FreeValue(HTValue_t value) {
+  free(value);
+}
+
+// Reads all of a trace file into *trace.  Exits with an error if the file
+// can't be read or isn't a trace.
+static void LoadTrace(const char *path, Trace *trace) {
+  FILE *file = fopen(path, "rb");
+  size_t capacity = 1024;
+  HTTraceRecord record;
+
+  if (file == NULL) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  if (!HTTrace_ReadHeader(file)) {
+    fprintf(stderr, "%s: not a HashTable trace\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  memset(trace, 0, sizeof(Trace));
+  trace->records = (HTTraceRecord *) malloc(capacity * sizeof(HTTraceRecord));
+  Verify333(trace->records != NULL);
+  while (HTTrace_ReadRecord(file, &record)) {
+    if (record.op < HT_TRACE_BEGIN || record.op > HT_TRACE_FREE) {
+      fprintf(stderr, "%s: bad record %zu\n", path, trace->num_records);
+      exit(EXIT_FAILURE);
+    }
+    if (trace->num_records == capacity) {
+      capacity *= 2;
+      trace->records = (HTTraceRecord *)
+          realloc(trace->records, capacity * sizeof(HTTraceRecord));
+      Verify333(trace->records != NULL);
+    }
+    trace->records[trace->num_records++] = record;
+    trace->counts[record.op]++;
+  }
+  fclose(file);
+}
+
+// Replays one record against *table, which a HT_TRACE_BEGIN (re)allocates
+// and a HT_TRACE_FREE frees.
+static void ReplayRecord(const HTTraceRecord *record,
+                         const HTOptions *options, HashTable **table) {
+  HTKeyValue_t kv, oldkv;
+  HTValue_t *slot;
+  bool inserted;
+
+  // Traces cut short (say, by a crash) may be missing their
+  // HT_TRACE_FREE, so ops on a freed table start a new one.
+  if (*table == NULL && record->op != HT_TRACE_BEGIN) {
+    *table = HashTable_AllocateWithOptions(16, options);
+  }
+
+  switch (record->op) {
+    case HT_TRACE_BEGIN:
+      if (*table != NULL) {
+        HashTable_Free(*table, &FreeValue);
+      }
+      *table = HashTable_AllocateWithOptions(
+          record->key > 0 ? (int) record->key : 1, options);
+      break;
+    case HT_TRACE_INSERT:
+      kv.key = record->key;
+      kv.value = NULL;
+      if (alloc_values && record->size_class > 0) {
+        kv.value = malloc((size_t) 1 << (record->size_class - 1));
+        Verify333(kv.value != NULL);
+      }
+      if (HashTable_Insert(*table, kv, &oldkv)) {
+        free(oldkv.value);
+      }
+      break;
+    case HT_TRACE_FIND:
+      HashTable_Find(*table, record->key, &kv);
+      break;
+    case HT_TRACE_FIND_OR_INSERT:
+      HashTable_FindOrInsert(*table, record->key, &slot, &inserted);
+      break;
+    case HT_TRACE_REMOVE:
+      if (HashTable_Remove(*table, record->key, &oldkv)) {
+        free(oldkv.value);
+      }
+      break;
+    case HT_TRACE_ITERATE: {
+      HTIterator *it = HTIterator_Allocate(*table);
+      for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+        HTIterator_Get(it, &kv);
+      }
+      HTIterator_Free(it);
+      break;
+    }
+    case HT_TRACE_RESERVE:
+      HashTable_Reserve(*table, (int) record->key);
+      break;
+    case HT_TRACE_COMPACT:
+      HashTable_Compact(*table);
+      break;
+    case HT_TRACE_FREE:
+      HashTable_Free(*table, &FreeValue);
+      *table = NULL;
+      break;
+  }
+}
+
+// Replays a whole trace and returns how long it took, in nanoseconds.  If
+// latency isn't NULL, each call is timed too, and recorded in latency[op].
+static uint64_t Replay(const Trace *trace, const HTOptions *options,
+                       HTLatencyHistogram *latency) {
+  HashTable *table = NULL;
+  uint64_t start = Bench_Now();
+
+  for (size_t i = 0; i < trace->num_records; i++) {
+    const HTTraceRecord *record = &trace->records[i];
+    if (latency == NULL) {
+      ReplayRecord(record, options, &table);
+    } else {
+      uint64_t op_start = Bench_Now();
+      ReplayRecord(record, options, &table);
+      HTLatency_Record(&latency[record->op], Bench_Now() - op_start);
+    }
+  }
+  uint64_t nanos = Bench_Now() - start;
+
+  if (table != NULL) {
+    HashTable_Free(table, &FreeValue);
+  }
+  return nanos;
+}
+
+// Prints one result line of the report.
+static void PrintResult(bool first, const char *op, uint64_t num_ops,
+                        uint64_t nanos, const HTLatencyHistogram *latency) {
+  double ns_per_op = num_ops > 0 ? (double) nanos / num_ops : 0.0;
+  double ops_per_sec = nanos > 0 ? num_ops * 1e9 / nanos : 0.0;
+
+  printf("%s\n    {\"op\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.2f, "
+         "\"ops_per_sec\": %.0f", first ? "" : ",", op,
+         (unsigned long long) num_ops, ns_per_op, ops_per_sec);
+  if (latency != NULL) {
+    printf(", \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+           "\"max_ns\": %llu",
+           (unsigned long long) HTLatency_Percentile(latency, 50.0),
+           (unsigned long long) HTLatency_Percentile(latency, 99.0),
+           (unsigned long long) HTLatency_Percentile(latency, 99.9),
+           (unsigned long long) latency->max_ns);
+  }
+  printf("}");
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-e flat] [-x modulo|mask|fastrange] [-i] [-a]\n"
+          "       [-l max_load] [-g growth] [-s min_load] [-v] trace\n",
+          program);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  HTOptions options;
+  Trace trace;
+  int opt;
+
+  HTOptions_Init(&options);
+  while ((opt = getopt(argc, argv, "e:x:ial:g:s:v")) != -1) {
+    switch (opt) {
+      case 'e':
+        if (strcmp(optarg, "flat") == 0) {
+          options.engine = HT_ENGINE_FLAT;
+        } else if (strcmp(optarg, "chained") != 0) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'x':
+        if (!Bench_ParseIndexMode(optarg, &options.index_mode)) {
+          Usage(argv[0]);
+        }
+        break;
+      case 'i':
+        options.incremental_resize = true;
+        break;
+      case 'a':
+        options.arena = true;
+        break;
+      case 'l':
+        options.max_load_factor = atof(optarg);
+        break;
+      case 'g':
+        options.growth_factor = atof(optarg);
+        break;
+      case 's':
+        options.min_load_factor = atof(optarg);
+        break;
+      case 'v':
+        alloc_values = true;
+        break;
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) {
+    Usage(argv[0]);
+  }
+  LoadTrace(argv[optind], &trace);
+
+  // The histograms are big, so they aren't kept on the stack.
+  HTLatencyHistogram *latency = (HTLatencyHistogram *)
+      calloc(NUM_OPS, sizeof(HTLatencyHistogram));
+  Verify333(latency != NULL);
+
+  uint64_t nanos = Replay(&trace, &options, NULL);
+  Replay(&trace, &options, latency);
+
+  printf("{\n  \"benchmark\": \"replay_hashtable\",\n  \"config\": "
+         "{\"trace\": \"%s\", \"engine\": \"%s\", \"index_mode\": \"%s\", "
+         "\"incremental_resize\": %s, \"arena\": %s, "
+         "\"max_load_factor\": %g, \"growth_factor\": %g, "
+         "\"min_load_factor\": %g, \"values\": %s},\n"
+         "  \"peak_rss_kib\": %ld,\n  \"results\": [",
+         argv[optind], options.engine == HT_ENGINE_FLAT ? "flat" : "chained",
+         Bench_IndexModeName(options.index_mode),
+         options.incremental_resize ? "true" : "false",
+         options.arena ? "true" : "false", options.max_load_factor,
+         options.growth_factor, options.min_load_factor,
+         alloc_values ? "true" : "false", Bench_PeakRSSKiB());
+
+  // The whole trace's throughput, then each op's share and latencies.
+  PrintResult(true, "all", trace.num_records, nanos, NULL);
+  for (size_t op = HT_TRACE_INSERT; op < NUM_OPS; op++) {
+    if (trace.counts[op] > 0) {
+      PrintResult(false, kOpNames[op], trace.counts[op],
+                  latency[op].total_ns, &latency[op]);
+    }
+  }
+  printf("\n  ]\n}\n");
+
+  free(latency);
+  free(trace.records);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+#include "./test_alloc_counter.h"
+
+// Whether an AllocCounter is live, and what it has counted.
+static bool counting = false;
+static uint64_t num_allocs = 0;
+static uint64_t num_frees = 0;
+
+// The real allocator, and the wrappers the linker substitutes for it; see
+// the test_suite target in the Makefile.
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_calloc(size_t count, size_t size);
+  void* __real_realloc(void *ptr, size_t size);
+  void __real_free(void *ptr);
+
+  void* __wrap_malloc(size_t size) {
+    num_allocs += counting;
+    return __real_malloc(size);
+  }
+
+  void* __wrap_calloc(size_t count, size_t size) {
+    num_allocs += counting;
+    return __real_calloc(count, size);
+  }
+
+  void* __wrap_realloc(void *ptr, size_t size) {
+    num_allocs += counting;
+    return __real_realloc(ptr, size);
+  }
+
+  void __wrap_free(void *ptr) {
+    num_frees += counting && ptr != NULL;
+    __real_free(ptr);
+  }
+}
+
+namespace hw1 {
+
+AllocCounter::AllocCounter() {
+  EXPECT_FALSE(counting) << "AllocCounters don't nest";
+  num_allocs = 0;
+  num_frees = 0;
+  counting = true;
+}
+
+AllocCounter::~AllocCounter() {
+  counting = false;
+}
+
+uint64_t AllocCounter::allocs() const {
+  return num_allocs;
+}
+
+uint64_t AllocCounter::frees() const {
+  return num_frees;
+}
+
+}  // namespace hw1
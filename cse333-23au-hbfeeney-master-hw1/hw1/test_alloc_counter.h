@@ -0,0 +1,41 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#ifndef HW1_TEST_ALLOC_COUNTER_H_
+#define HW1_TEST_ALLOC_COUNTER_H_
+
+#include <stdint.h>
+
+namespace hw1 {
+
+// Counts the heap allocations the hw1 library makes while it's in scope,
+// so that tests can hold operations to an allocation budget.
+//
+// The test build links with -Wl,--wrap=malloc (and calloc, realloc and
+// free), which sends every call the library makes to those functions
+// through test_alloc_counter.cc first.  Calls made from shared libraries,
+// such as operator new in libstdc++, aren't seen.  Counters don't nest.
+class AllocCounter {
+ public:
+  // Starts counting from zero.
+  AllocCounter();
+  // Stops counting.
+  ~AllocCounter();
+
+  // The number of malloc, calloc and realloc calls so far.
+  uint64_t allocs() const;
+  // The number of free calls so far, not counting free(NULL).
+  uint64_t frees() const;
+};
+
+}  // namespace hw1
+
+#endif  // HW1_TEST_ALLOC_COUNTER_H_
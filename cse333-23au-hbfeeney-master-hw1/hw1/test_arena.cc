@@ -0,0 +1,93 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+  #include "./Arena.h"
+  #include "./Slab.h"
+}
+
+#include "./test_suite.h"
+
+namespace hw1 {
+
+// Returns the number of chunks in arena.
+static int NumChunks(const Arena *arena) {
+  int n = 0;
+  for (ArenaChunk *chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+    n++;
+  }
+  return n;
+}
+
+TEST(Test_Arena, AllocRelease) {
+  Arena arena;
+  Arena_Init(&arena, 1024, NULL);
+  ASSERT_EQ(0, NumChunks(&arena));
+
+  // Small allocations are aligned and share a chunk.
+  char *a = static_cast<char *>(Arena_Alloc(&arena, 1));
+  char *b = static_cast<char *>(Arena_Alloc(&arena, 24));
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(a) % 16);
+  ASSERT_EQ(a + 16, b);
+  ASSERT_EQ(1, NumChunks(&arena));
+
+  // A big allocation gets a chunk of its own, and the current chunk
+  // carries on.
+  char *big = static_cast<char *>(Arena_Calloc(&arena, 1000, 1));
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(0, big[i]);
+  }
+  ASSERT_EQ(2, NumChunks(&arena));
+  ASSERT_EQ(b + 32, Arena_Alloc(&arena, 16));
+
+  // Filling the chunk starts another; calloc'ed memory is zeroed even
+  // when it's carved from a chunk.
+  for (int i = 0; i < 100; i++) {
+    memset(Arena_Alloc(&arena, 100), 0xFF, 100);
+  }
+  char *zeroed = static_cast<char *>(Arena_Calloc(&arena, 10, 10));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(0, zeroed[i]);
+  }
+  ASSERT_GT(NumChunks(&arena), 2);
+
+  Arena_Release(&arena);
+  ASSERT_EQ(0, NumChunks(&arena));
+  ASSERT_NE(nullptr, Arena_Alloc(&arena, 8));
+  Arena_Release(&arena);
+}
+
+TEST(Test_Arena, SlabInArena) {
+  Arena arena;
+  Slab slab;
+  Arena_Init(&arena, 1 << 16, NULL);
+  Slab_InitInArena(&slab, 24, &arena);
+
+  for (int i = 0; i < 1000; i++) {
+    memset(Slab_Alloc(&slab), i & 0xFF, 24);
+  }
+  ASSERT_GT(NumChunks(&arena), 0);
+
+  // Releasing the slab leaves its pages to the arena.
+  int num_chunks = NumChunks(&arena);
+  Slab_Release(&slab);
+  ASSERT_EQ(nullptr, slab.pages);
+  ASSERT_EQ(&arena, slab.arena);
+  ASSERT_EQ(num_chunks, NumChunks(&arena));
+  Arena_Release(&arena);
+}
+
+}  // namespace hw1
@@ -18,6 +18,7 @@ extern "C" {
 
 #include "gtest/gtest.h"
 
+#include "./test_alloc_counter.h"
 #include "./test_suite.h"
 
 namespace hw1 {
@@ -32,6 +33,20 @@ class Test_HashTable : public ::testing::Test {
  protected:
   static const int kMagicNum = 0xDEADBEEF;
 
+  // The configurations most tests run against, by index in the array
+  // StandardOptions fills: the defaults, then incremental resizing, arena
+  // mode and the flat engine, each on its own.  The chained ones come
+  // first, so the first kFlat entries are all chained.
+  enum { kDefault, kIncremental, kArena, kFlat, kNumOptions };
+  static void StandardOptions(HTOptions opts[kNumOptions]) {
+    for (int i = 0; i < kNumOptions; i++) {
+      HTOptions_Init(&opts[i]);
+    }
+    opts[kIncremental].incremental_resize = true;
+    opts[kArena].arena = true;
+    opts[kFlat].engine = HT_ENGINE_FLAT;
+  }
+
   // Code here will be called before each test executes (ie, before
   // each TEST_F).
   virtual void SetUp() {
@@ -65,9 +80,9 @@ TEST_F(Test_HashTable, AllocFree) {
   ASSERT_EQ(3, ht->num_buckets);
 
   ASSERT_TRUE(ht->buckets != NULL);
-  ASSERT_EQ(0, LinkedList_NumElements(ht->buckets[0]));
-  ASSERT_EQ(0, LinkedList_NumElements(ht->buckets[1]));
-  ASSERT_EQ(0, LinkedList_NumElements(ht->buckets[2]));
+  ASSERT_EQ(NULL, ht->buckets[0]);
+  ASSERT_EQ(NULL, ht->buckets[1]);
+  ASSERT_EQ(NULL, ht->buckets[2]);
   HashTable_Free(ht, &Test_HashTable::VerifiedFree);
 }
 
@@ -393,4 +408,1179 @@ TEST_F(Test_HashTable, Resize) {
   HW1Environment::AddPoints(10);
 }
 
+TEST_F(Test_HashTable, ResizeRelinksNodes) {
+  HashTable *table = HashTable_Allocate(1);
+  HTKeyValue_t newkv, oldkv;
+
+  // Fill the single bucket right up to the resize threshold.
+  for (int i = 0; i < 3; i++) {
+    newkv.key = i;
+    newkv.value = NULL;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  HTNode *nodes[3];
+  HTNode *node = table->buckets[0];
+  for (int i = 0; i < 3; i++, node = node->next) {
+    nodes[node->kv.key] = node;
+  }
+
+  // The next insert resizes.  The existing nodes must have been moved
+  // into their new buckets rather than reallocated.
+  newkv.key = 3;
+  ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  ASSERT_EQ(9, table->num_buckets);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(nodes[i], table->buckets[i]);
+    ASSERT_EQ(NULL, table->buckets[i]->next);
+  }
+  HashTable_Free(table, NoOpFree);
+}
+
+// Asserts that table's occupancy bitmap matches its buckets.
+static void VerifyOccupancy(HashTable *table) {
+  for (int b = 0; b < table->num_buckets; b++) {
+    bool bit = (table->occupied[b / 64] >> (b % 64)) & 1;
+    ASSERT_EQ(table->buckets[b] != NULL, bit);
+  }
+}
+
+TEST_F(Test_HashTable, OccupancyBitmap) {
+  HashTable *table = HashTable_Allocate(100000);
+  HTKeyValue_t newkv, oldkv;
+  VerifyOccupancy(table);
+
+  // Scatter a few keys across the sparse table, two per bucket.
+  for (int i = 0; i < 20; i++) {
+    newkv.key = (i / 2) * 9973 + (i % 2) * 100000;
+    newkv.value = NULL;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  VerifyOccupancy(table);
+
+  // Removing one key of a pair keeps the bucket occupied; removing
+  // both empties it.
+  ASSERT_TRUE(HashTable_Remove(table, 0, &oldkv));
+  VerifyOccupancy(table);
+  ASSERT_TRUE(HashTable_Remove(table, 100000, &oldkv));
+  VerifyOccupancy(table);
+  ASSERT_EQ(NULL, table->buckets[0]);
+
+  // Iteration only visits what's there, including through removals.
+  int num_seen = 0;
+  HTIterator *it = HTIterator_Allocate(table);
+  while (HTIterator_IsValid(it)) {
+    ASSERT_TRUE(HTIterator_Get(it, &oldkv));
+    if (++num_seen % 3 == 0) {
+      ASSERT_TRUE(HTIterator_Remove(it, &oldkv));
+    } else {
+      HTIterator_Next(it);
+    }
+  }
+  HTIterator_Free(it);
+  ASSERT_EQ(18, num_seen);
+  ASSERT_EQ(12, HashTable_NumElements(table));
+  VerifyOccupancy(table);
+
+  HashTable_Free(table, NoOpFree);
+}
+
+TEST_F(Test_HashTable, IteratorRemoveInPlace) {
+  HashTable *table = HashTable_Allocate(100);
+  HTKeyValue_t newkv, oldkv;
+  HTKey_t order[200];
+
+  // Chains of several nodes in a few buckets, so that removals hit the
+  // head, middle and tail of chains.
+  for (int i = 0; i < 200; i++) {
+    newkv.key = (i % 20) * 7 + (i / 20) * 100;
+    newkv.value = NULL;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  HTIterator *it = HTIterator_Allocate(table);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_TRUE(HTIterator_Get(it, &oldkv));
+    order[i] = oldkv.key;
+    HTIterator_Next(it);
+  }
+  ASSERT_FALSE(HTIterator_IsValid(it));
+  HTIterator_Free(it);
+
+  // Removing lands the iterator where Next would have, so the visit order
+  // is unchanged.
+  it = HTIterator_Allocate(table);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_TRUE(HTIterator_Get(it, &oldkv));
+    ASSERT_EQ(order[i], oldkv.key);
+    if (oldkv.key % 3 == 0) {
+      ASSERT_TRUE(HTIterator_Remove(it, &newkv));
+      ASSERT_EQ(oldkv.key, newkv.key);
+    } else {
+      HTIterator_Next(it);
+    }
+    VerifyOccupancy(table);
+  }
+  ASSERT_FALSE(HTIterator_IsValid(it));
+  ASSERT_FALSE(HTIterator_Remove(it, &oldkv));
+  HTIterator_Free(it);
+
+  // Empty the rest of the table.
+  it = HTIterator_Allocate(table);
+  while (HTIterator_Remove(it, &oldkv)) {
+    ASSERT_NE(0U, oldkv.key % 3);
+  }
+  HTIterator_Free(it);
+  ASSERT_EQ(0, HashTable_NumElements(table));
+  VerifyOccupancy(table);
+  for (int b = 0; b < table->num_buckets; b++) {
+    ASSERT_EQ(NULL, table->buckets[b]);
+  }
+
+  HashTable_Free(table, NoOpFree);
+}
+
+TEST_F(Test_HashTable, IndexModes) {
+  HTIndexMode_t modes[] = { HT_INDEX_MASK, HT_INDEX_FASTRANGE };
+
+  for (HTIndexMode_t mode : modes) {
+    HTOptions opts;
+    HTOptions_Init(&opts);
+    opts.index_mode = mode;
+    HashTable *table = HashTable_AllocateWithOptions(5, &opts);
+    ASSERT_EQ(mode == HT_INDEX_MASK ? 8 : 5, table->num_buckets);
+
+    // Keys that are all multiples of 64 would land in a handful of buckets
+    // under plain modulo; the mixer should spread them out.
+    HTKeyValue_t newkv, oldkv;
+    for (int i = 0; i < 1000; i++) {
+      newkv.key = static_cast<HTKey_t>(i) * 64;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    if (mode == HT_INDEX_MASK) {
+      ASSERT_EQ(0, table->num_buckets & (table->num_buckets - 1));
+    }
+    int max_chain = 0;
+    for (int b = 0; b < table->num_buckets; b++) {
+      int len = 0;
+      for (HTNode *node = table->buckets[b]; node != NULL; node = node->next) {
+        ASSERT_EQ(b, HashKeyToBucketNum(table, node->kv.key));
+        len++;
+      }
+      max_chain = len > max_chain ? len : max_chain;
+    }
+    ASSERT_GE(12, max_chain);
+
+    for (int i = 0; i < 1000; i++) {
+      HTKey_t key = static_cast<HTKey_t>(i) * 64;
+      ASSERT_TRUE(HashTable_Find(table, key, &oldkv));
+      ASSERT_FALSE(HashTable_Find(table, key + 1, &oldkv));
+    }
+    HashTable_Free(table, NoOpFree);
+  }
+}
+
+TEST_F(Test_HashTable, IncrementalResize) {
+  HTOptions opts;
+  HTOptions_Init(&opts);
+  opts.incremental_resize = true;
+  HashTable *table = HashTable_AllocateWithOptions(2, &opts);
+
+  HTKeyValue_t newkv, oldkv;
+
+  // Fill the table until it starts a resize.  The old buckets stay live and
+  // nothing has been migrated yet.
+  int num_keys = 0;
+  while (table->old_buckets == NULL) {
+    newkv.key = num_keys;
+    newkv.value = reinterpret_cast<HTValue_t>(static_cast<int64_t>(num_keys));
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    num_keys++;
+  }
+  ASSERT_EQ(2, table->old_num_buckets);
+  ASSERT_EQ(18, table->num_buckets);
+
+  // While the migration is paused by a live iterator, every element is
+  // still visited exactly once, and removing through the iterator works.
+  int num_times_seen[7] = { 0 };
+  ASSERT_EQ(7, num_keys);
+  HTIterator *it = HTIterator_Allocate(table);
+  while (HTIterator_IsValid(it)) {
+    ASSERT_TRUE(HTIterator_Get(it, &oldkv));
+    ASSERT_EQ(0, num_times_seen[oldkv.key]++);
+    if (oldkv.key == 3) {
+      ASSERT_TRUE(HTIterator_Remove(it, &oldkv));
+    } else {
+      HTIterator_Next(it);
+    }
+    ASSERT_TRUE(HashTable_Find(table, 0, &oldkv));
+  }
+  HTIterator_Free(it);
+  for (int i = 0; i < num_keys; i++) {
+    ASSERT_EQ(1, num_times_seen[i]);
+  }
+  ASSERT_EQ(0, table->migrate_idx);
+  ASSERT_EQ(6, HashTable_NumElements(table));
+
+  // Once the iterator is gone, each operation migrates a few buckets; the
+  // old array is released as soon as the last one moves.
+  ASSERT_FALSE(HashTable_Find(table, 3, &oldkv));
+  ASSERT_EQ(NULL, table->old_buckets);
+  for (int i = 0; i < num_keys; i++) {
+    ASSERT_EQ(i != 3, HashTable_Find(table, i, &oldkv));
+  }
+
+  // Grow through several more resizes, checking that the keys stay
+  // reachable while migrations are in flight.
+  for (int i = num_keys; i < 2000; i++) {
+    newkv.key = i;
+    newkv.value = reinterpret_cast<HTValue_t>(static_cast<int64_t>(i));
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    ASSERT_TRUE(HashTable_Find(table, i / 2, &oldkv) || i / 2 == 3);
+  }
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_EQ(i != 3, HashTable_Remove(table, i, &oldkv));
+  }
+  ASSERT_EQ(0, HashTable_NumElements(table));
+
+  // A leaked iterator only pauses lookups' share of the migration:
+  // insertions still finish it.  And an iterator can be freed after its
+  // table.
+  it = HTIterator_Allocate(table);
+  for (int i = 0; table->old_buckets == NULL; i++) {
+    newkv.key = i;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_FALSE(HashTable_Find(table, -1, &oldkv));
+  }
+  ASSERT_EQ(0, table->migrate_idx);
+  for (int i = -1; table->old_buckets != NULL; i--) {
+    newkv.key = i;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  HashTable_Free(table, NoOpFree);
+  HTIterator_Free(it);
+}
+
+TEST_F(Test_HashTable, FlatEngine) {
+  HTOptions opts;
+  HTOptions_Init(&opts);
+  opts.engine = HT_ENGINE_FLAT;
+  HashTable *table = HashTable_AllocateWithOptions(2, &opts);
+  ASSERT_EQ(HT_FLAT_GROUP, table->num_buckets);
+
+  HTKeyValue_t newkv, oldkv;
+  const int kNumKeys = 1000;
+
+  // Insert enough keys (with a stride, so they're not sequential) to force
+  // several rehashes, replacing each one once.
+  for (int i = 0; i < kNumKeys; i++) {
+    newkv.key = static_cast<HTKey_t>(i) * 1024;
+    newkv.value = reinterpret_cast<HTValue_t>(static_cast<int64_t>(i));
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    ASSERT_TRUE(HashTable_Insert(table, newkv, &oldkv));
+    ASSERT_EQ(newkv.key, oldkv.key);
+    ASSERT_EQ(newkv.value, oldkv.value);
+  }
+  ASSERT_EQ(kNumKeys, HashTable_NumElements(table));
+  ASSERT_LT(kNumKeys, table->num_buckets);
+
+  for (int i = 0; i < kNumKeys; i++) {
+    HTKey_t key = static_cast<HTKey_t>(i) * 1024;
+    ASSERT_TRUE(HashTable_Find(table, key, &oldkv));
+    ASSERT_EQ(key, oldkv.key);
+    ASSERT_EQ(reinterpret_cast<HTValue_t>(static_cast<int64_t>(i)),
+              oldkv.value);
+    ASSERT_FALSE(HashTable_Find(table, key + 1, &oldkv));
+  }
+
+  // Remove the even keys, then reinsert and remove them again so that
+  // tombstones get reused.
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < kNumKeys; i += 2) {
+      HTKey_t key = static_cast<HTKey_t>(i) * 1024;
+      ASSERT_TRUE(HashTable_Remove(table, key, &oldkv));
+      ASSERT_EQ(key, oldkv.key);
+      ASSERT_FALSE(HashTable_Remove(table, key, &oldkv));
+      ASSERT_FALSE(HashTable_Find(table, key, &oldkv));
+    }
+    ASSERT_EQ(kNumKeys / 2, HashTable_NumElements(table));
+    if (round == 0) {
+      for (int i = 0; i < kNumKeys; i += 2) {
+        newkv.key = static_cast<HTKey_t>(i) * 1024;
+        newkv.value = reinterpret_cast<HTValue_t>(static_cast<int64_t>(i));
+        ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+      }
+    }
+  }
+
+  // Iterate, removing every other element we visit.
+  int num_seen = 0, num_removed = 0;
+  HTIterator *it = HTIterator_Allocate(table);
+  while (HTIterator_IsValid(it)) {
+    ASSERT_TRUE(HTIterator_Get(it, &oldkv));
+    ASSERT_EQ(1U, (oldkv.key / 1024) % 2);
+    if (num_seen++ % 2 == 0) {
+      ASSERT_TRUE(HTIterator_Remove(it, &newkv));
+      ASSERT_EQ(oldkv.key, newkv.key);
+      num_removed++;
+    } else {
+      HTIterator_Next(it);
+    }
+  }
+  HTIterator_Free(it);
+  ASSERT_EQ(kNumKeys / 2, num_seen);
+  ASSERT_EQ(kNumKeys / 2 - num_removed, HashTable_NumElements(table));
+
+  HashTable_Free(table, NoOpFree);
+}
+
+TEST_F(Test_HashTable, Batch) {
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  // Deliberately not a multiple of HT_BATCH_WINDOW, so the window runs off
+  // the end of the batch part way through.  The table starts tiny so that
+  // the inserts resize it many times over, under a window already primed.
+  const int kNumKeys = 1000 + HT_BATCH_WINDOW / 2;
+  HTKeyValue_t newkvs[kNumKeys], oldkvs[kNumKeys];
+  HTKeyValue_t foundkvs[2 * kNumKeys];
+  HTKey_t keys[2 * kNumKeys];
+  bool flags[2 * kNumKeys];
+
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+
+    // Every key after the first half appears twice in the batch; the second
+    // copy must replace the first, just as sequential inserts would.
+    for (int i = 0; i < kNumKeys; i++) {
+      int k = i < kNumKeys / 2 ? i : kNumKeys / 2 + (i - kNumKeys / 2) / 2;
+      newkvs[i].key = static_cast<HTKey_t>(k) * 1024;
+      newkvs[i].value = reinterpret_cast<HTValue_t>(static_cast<int64_t>(i));
+    }
+    int num_distinct = kNumKeys / 2 + (kNumKeys - kNumKeys / 2 + 1) / 2;
+    ASSERT_EQ(kNumKeys - num_distinct,
+              HashTable_InsertBatch(table, newkvs, kNumKeys, oldkvs, flags));
+    ASSERT_EQ(num_distinct, HashTable_NumElements(table));
+    for (int i = 0; i < kNumKeys; i++) {
+      bool dup = i > kNumKeys / 2 && newkvs[i].key == newkvs[i - 1].key;
+      ASSERT_EQ(dup, flags[i]);
+      if (dup) {
+        ASSERT_EQ(newkvs[i - 1].key, oldkvs[i].key);
+        ASSERT_EQ(newkvs[i - 1].value, oldkvs[i].value);
+      }
+    }
+
+    // Look up every inserted key interleaved with a miss, and check the
+    // batch agrees with HashTable_Find.
+    for (int i = 0; i < kNumKeys; i++) {
+      keys[2 * i] = newkvs[i].key;
+      keys[2 * i + 1] = newkvs[i].key + 1;
+    }
+    ASSERT_EQ(kNumKeys,
+              HashTable_FindBatch(table, keys, 2 * kNumKeys, foundkvs, flags));
+    for (int i = 0; i < 2 * kNumKeys; i++) {
+      HTKeyValue_t kv;
+      ASSERT_EQ(HashTable_Find(table, keys[i], &kv), flags[i]);
+      if (flags[i]) {
+        ASSERT_EQ(kv.key, foundkvs[i].key);
+        ASSERT_EQ(kv.value, foundkvs[i].value);
+      }
+    }
+    ASSERT_EQ(0, HashTable_FindBatch(table, keys, 0, foundkvs, flags));
+
+    HashTable_Free(table, NoOpFree);
+  }
+}
+
+TEST_F(Test_HashTable, FindOrInsert) {
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+    HTValue_t *slot;
+    bool inserted;
+    HTKeyValue_t kv;
+
+    // Count occurrences of key % 100 over 1000 keys, using the value slot
+    // as a counter.
+    for (int i = 0; i < 1000; i++) {
+      HashTable_FindOrInsert(table, i % 100, &slot, &inserted);
+      ASSERT_EQ(i < 100, inserted);
+      if (inserted) {
+        ASSERT_EQ(nullptr, *slot);
+      }
+      *slot = reinterpret_cast<HTValue_t>(
+          reinterpret_cast<intptr_t>(*slot) + 1);
+    }
+    ASSERT_EQ(100, HashTable_NumElements(table));
+    for (int i = 0; i < 100; i++) {
+      ASSERT_TRUE(HashTable_Find(table, i, &kv));
+      ASSERT_EQ(static_cast<HTKey_t>(i), kv.key);
+      ASSERT_EQ(10, reinterpret_cast<intptr_t>(kv.value));
+    }
+
+    // A replacing insert is visible through the slot.
+    kv.key = 7;
+    kv.value = reinterpret_cast<HTValue_t>(42);
+    ASSERT_TRUE(HashTable_Insert(table, kv, &kv));
+    HashTable_FindOrInsert(table, 7, &slot, &inserted);
+    ASSERT_FALSE(inserted);
+    ASSERT_EQ(reinterpret_cast<HTValue_t>(42), *slot);
+
+    HashTable_Free(table, NoOpFree);
+  }
+}
+
+// A HashTable_RemoveIf predicate that matches keys divisible by *ctx.
+static bool KeyDivisibleBy(HTKeyValue_t kv, void *ctx) {
+  return kv.key % *static_cast<HTKey_t *>(ctx) == 0;
+}
+
+// A HashTable_RemoveIf predicate that matches keys of at least *ctx.
+static bool KeyAtLeast(HTKeyValue_t kv, void *ctx) {
+  return kv.key >= *static_cast<HTKey_t *>(ctx);
+}
+
+static int num_values_freed;
+static void CountingFree(HTValue_t freeme) { num_values_freed++; }
+
+TEST_F(Test_HashTable, RemoveIf) {
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(37, &opts[t]);
+    HTKeyValue_t newkv, oldkv;
+    HTKey_t divisor;
+
+    // The last insert takes the table to 27 * 37 buckets, which leaves the
+    // incremental table at the start of a migration, so the sweep has to
+    // cover both bucket arrays.
+    for (int i = 0; i < 1000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    if (t == kIncremental) {
+      ASSERT_NE(nullptr, table->old_buckets);
+    }
+
+    num_values_freed = 0;
+    divisor = 3;
+    ASSERT_EQ(334, HashTable_RemoveIf(table, KeyDivisibleBy, &divisor,
+                                      CountingFree, false));
+    ASSERT_EQ(334, num_values_freed);
+    ASSERT_EQ(666, HashTable_NumElements(table));
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(i % 3 != 0, HashTable_Find(table, i, &oldkv));
+    }
+
+    // Without a free function, values are left alone.
+    divisor = 2;
+    ASSERT_EQ(333, HashTable_RemoveIf(table, KeyDivisibleBy, &divisor,
+                                      NULL, false));
+    ASSERT_EQ(334, num_values_freed);
+    divisor = 1000;
+    ASSERT_EQ(0, HashTable_RemoveIf(table, KeyDivisibleBy, &divisor, NULL,
+                                    false));
+
+    // A table left sparse keeps its size unless the caller asks for a
+    // shrink (these tables have no min_load_factor), and then it's
+    // right-sized whatever the engine, even if nothing more is removed.
+    int num_buckets = table->num_buckets;
+    HTKey_t limit = 100;
+    ASSERT_EQ(300, HashTable_RemoveIf(table, KeyAtLeast, &limit, NULL,
+                                      false));
+    ASSERT_EQ(num_buckets, table->num_buckets);
+    ASSERT_EQ(0, HashTable_RemoveIf(table, KeyAtLeast, &limit, NULL, true));
+    ASSERT_LT(table->num_buckets, num_buckets);
+    ASSERT_EQ(33, HashTable_NumElements(table));
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(i % 2 != 0 && i % 3 != 0 && i < 100,
+                HashTable_Find(table, i, &oldkv));
+    }
+
+    divisor = 1;
+    ASSERT_EQ(33, HashTable_RemoveIf(table, KeyDivisibleBy, &divisor,
+                                     CountingFree, false));
+    ASSERT_EQ(0, HashTable_NumElements(table));
+    if (table->engine == HT_ENGINE_CHAINED && table->old_buckets == NULL) {
+      VerifyOccupancy(table);
+    }
+
+    HTIterator *it = HTIterator_Allocate(table);
+    ASSERT_FALSE(HTIterator_IsValid(it));
+    HTIterator_Free(it);
+    HashTable_Free(table, NoOpFree);
+  }
+}
+
+TEST_F(Test_HashTable, ShrinkAndCompact) {
+  // The default table never shrinks; the incremental one shrinks, and so
+  // does the arena one, which also keeps to powers of two.
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+  opts[kIncremental].min_load_factor = 0.1;
+  opts[kArena].min_load_factor = 0.1;
+  opts[kArena].index_mode = HT_INDEX_MASK;
+
+  for (int t = 0; t < kFlat; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+    HTKeyValue_t newkv, oldkv;
+
+    for (int i = 0; i < 10000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    int peak_buckets = table->num_buckets;
+
+    // Drain most of the table.  With a minimum load factor the table
+    // shrinks on the way down, but never below the load that would make
+    // it grow again.
+    for (int i = 0; i < 9990; i++) {
+      ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+      ASSERT_LT(HashTable_NumElements(table), 3 * table->num_buckets);
+    }
+    if (opts[t].min_load_factor > 0.0) {
+      ASSERT_GE(HashTable_NumElements(table),
+                opts[t].min_load_factor * table->num_buckets);
+      ASSERT_LT(table->num_buckets, peak_buckets / 100);
+    } else {
+      ASSERT_EQ(peak_buckets, table->num_buckets);
+    }
+    for (int i = 0; i < 10000; i++) {
+      ASSERT_EQ(i >= 9990, HashTable_Find(table, i, &oldkv));
+    }
+
+    // Compacting right-sizes the table at one bucket per element.
+    HashTable_Compact(table);
+    ASSERT_EQ(NULL, table->old_buckets);
+    ASSERT_EQ(t == kArena ? 16 : 10, table->num_buckets);
+    VerifyOccupancy(table);
+    for (int i = 9990; i < 10000; i++) {
+      ASSERT_TRUE(HashTable_Find(table, i, &oldkv));
+    }
+
+    // An empty table compacts to a single bucket and still works.
+    for (int i = 9990; i < 10000; i++) {
+      ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+    }
+    HashTable_Compact(table);
+    ASSERT_EQ(1, table->num_buckets);
+    newkv.key = 42;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    ASSERT_TRUE(HashTable_Find(table, 42, &oldkv));
+
+    HashTable_Free(table, NoOpFree);
+  }
+
+  // A flat table compacts to the smallest capacity that holds its entries
+  // comfortably, dropping its tombstones.
+  HashTable *table = HashTable_AllocateWithOptions(2, &opts[kFlat]);
+  HTKeyValue_t newkv, oldkv;
+  for (int i = 0; i < 1000; i++) {
+    newkv.key = i;
+    newkv.value = NULL;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  for (int i = 10; i < 1000; i++) {
+    ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+  }
+  HashTable_Compact(table);
+  ASSERT_EQ(32, table->num_buckets);
+  ASSERT_EQ(0, table->num_deleted);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(i < 10, HashTable_Find(table, i, &oldkv));
+  }
+  HashTable_Free(table, NoOpFree);
+}
+
+TEST_F(Test_HashTable, GrowthPolicy) {
+  // The flat engine ignores the load settings, so only the chained tables
+  // are tuned: the incremental one also keeps to powers of two, and the
+  // arena one grows by a factor too small to get under the maximum load.
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+  for (int i = 0; i < kFlat; i++) {
+    opts[i].max_load_factor = 0.75;
+    opts[i].growth_factor = 2.0;
+    opts[i].min_load_factor = 0.2;
+  }
+  opts[kIncremental].index_mode = HT_INDEX_MASK;
+  opts[kIncremental].growth_factor = 3.0;  // rounds down to 2 in mask mode
+  opts[kArena].growth_factor = 1.1;
+  opts[kArena].min_load_factor = 0.0;
+
+  for (int t = 0; t < kFlat; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(8, &opts[t]);
+    HTKeyValue_t newkv, oldkv;
+    int num_buckets = table->num_buckets;
+
+    for (int i = 0; i < 5000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+      ASSERT_LE(HashTable_NumElements(table),
+                opts[t].max_load_factor * table->num_buckets + 1);
+      if (table->num_buckets != num_buckets) {
+        // A small factor grows by more if that's what it takes to get
+        // back under the maximum load.
+        int expected =
+            static_cast<int>(num_buckets * (t == kArena ? 1.1 : 2.0));
+        if (t == kArena) {
+          ASSERT_LE(expected, table->num_buckets);
+        } else {
+          ASSERT_EQ(expected, table->num_buckets);
+        }
+        num_buckets = table->num_buckets;
+      }
+    }
+    for (int i = 0; i < 5000; i++) {
+      ASSERT_TRUE(HashTable_Find(table, i, &oldkv));
+    }
+
+    // A table tuned for short chains compacts to half its maximum load.
+    for (int i = 10; i < 5000; i++) {
+      ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+    }
+    HashTable_Compact(table);
+    ASSERT_EQ(t == kIncremental ? 32 : 27, table->num_buckets);
+
+    HashTable_Free(table, NoOpFree);
+  }
+}
+
+TEST_F(Test_HashTable, ReserveAndBuild) {
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+  HTKeyValue_t newkv, oldkv;
+
+  // After reserving, filling the table never resizes it, and a chained
+  // table takes every node from a single contiguous slab page.
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+    HashTable_Reserve(table, 10000);
+    int num_buckets = table->num_buckets;
+    for (int i = 0; i < 10000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    ASSERT_EQ(num_buckets, table->num_buckets);
+    if (t != kFlat) {
+      ASSERT_NE(nullptr, table->node_slab.pages);
+      ASSERT_EQ(nullptr, table->node_slab.pages->next);
+      ASSERT_EQ(10000U, table->node_slab.pages->capacity);
+    }
+
+    // Nodes from the block can still be removed, and the table can grow
+    // past the reservation with ordinary nodes.
+    for (int i = 0; i < 10000; i += 2) {
+      ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+    }
+    for (int i = 10000; i < 20000; i++) {
+      newkv.key = i;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    ASSERT_EQ(15000, HashTable_NumElements(table));
+    HashTable_Free(table, NoOpFree);
+  }
+
+  // Build from an array where keys 0..999 appear twice.
+  const int kNumPairs = 3000;
+  HTKeyValue_t kvs[kNumPairs];
+  for (int i = 0; i < kNumPairs; i++) {
+    kvs[i].key = i % 2000;
+    kvs[i].value = reinterpret_cast<HTValue_t>(static_cast<intptr_t>(i));
+  }
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *replace = HashTable_BuildFromArray(kvs, kNumPairs,
+                                                  HT_DUP_REPLACE, &opts[t]);
+    HashTable *keep = HashTable_BuildFromArray(kvs, kNumPairs,
+                                               HT_DUP_KEEP_FIRST, &opts[t]);
+    HashTable *unique = HashTable_BuildFromArray(kvs, 2000, HT_DUP_UNIQUE,
+                                                 &opts[t]);
+    ASSERT_EQ(2000, HashTable_NumElements(replace));
+    ASSERT_EQ(2000, HashTable_NumElements(keep));
+    ASSERT_EQ(2000, HashTable_NumElements(unique));
+    for (int i = 0; i < 2000; i++) {
+      intptr_t last = i < 1000 ? i + 2000 : i;
+      ASSERT_TRUE(HashTable_Find(replace, i, &oldkv));
+      ASSERT_EQ(last, reinterpret_cast<intptr_t>(oldkv.value));
+      ASSERT_TRUE(HashTable_Find(keep, i, &oldkv));
+      ASSERT_EQ(i, reinterpret_cast<intptr_t>(oldkv.value));
+      ASSERT_TRUE(HashTable_Find(unique, i, &oldkv));
+      ASSERT_EQ(i, reinterpret_cast<intptr_t>(oldkv.value));
+    }
+    ASSERT_FALSE(HashTable_Find(unique, 2000, &oldkv));
+    if (t != kFlat) {
+      VerifyOccupancy(unique);
+    }
+
+    // Built tables are ordinary tables from then on.
+    newkv.key = 5000;
+    ASSERT_FALSE(HashTable_Insert(unique, newkv, &oldkv));
+    ASSERT_TRUE(HashTable_Remove(unique, 0, &oldkv));
+    ASSERT_EQ(2000, HashTable_NumElements(unique));
+
+    HashTable_Free(replace, NoOpFree);
+    HashTable_Free(keep, NoOpFree);
+    HashTable_Free(unique, NoOpFree);
+  }
+
+  HashTable *empty = HashTable_BuildFromArray(kvs, 0, HT_DUP_UNIQUE, NULL);
+  ASSERT_EQ(0, HashTable_NumElements(empty));
+  HashTable_Free(empty, NoOpFree);
+}
+
+TEST_F(Test_HashTable, ArenaMode) {
+  HTOptions opts;
+  HTOptions_Init(&opts);
+  opts.arena = true;
+  HTKeyValue_t newkv, oldkv;
+
+  for (int round = 0; round < 2; round++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts);
+    for (int i = 0; i < 100000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+
+    // Removed nodes are reused rather than taking more arena memory.
+    ArenaChunk *newest = table->arena.chunks;
+    for (int i = 0; i < 100000; i += 2) {
+      ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+    }
+    for (int i = 0; i < 100000; i += 2) {
+      newkv.key = i;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    ASSERT_EQ(newest, table->arena.chunks);
+
+    // All of the nodes fit in a handful of chunks.
+    int num_chunks = 0;
+    for (ArenaChunk *c = table->arena.chunks; c != NULL; c = c->next) {
+      num_chunks++;
+    }
+    ASSERT_LE(num_chunks, 4);
+
+    for (int i = 0; i < 100000; i++) {
+      ASSERT_TRUE(HashTable_Find(table, i, &oldkv));
+    }
+
+    // Free visits every value when asked to, and skips them given NULL.
+    num_values_freed = 0;
+    HashTable_Free(table, round == 0 ? CountingFree : NULL);
+    ASSERT_EQ(round == 0 ? 100000 : 0, num_values_freed);
+  }
+}
+
+// Allocator state for the Allocator test: what's outstanding, and whether
+// every free came with the size that was allocated.
+typedef struct {
+  int    num_allocs;
+  int    num_frees;
+  size_t bytes_live;
+} AllocStats;
+
+static void* CountingAlloc(void *ctx, size_t size) {
+  AllocStats *stats = static_cast<AllocStats *>(ctx);
+  size_t *block = static_cast<size_t *>(malloc(sizeof(max_align_t) + size));
+  *block = size;
+  stats->num_allocs++;
+  stats->bytes_live += size;
+  return reinterpret_cast<char *>(block) + sizeof(max_align_t);
+}
+
+static void CountingDealloc(void *ctx, void *ptr, size_t size) {
+  AllocStats *stats = static_cast<AllocStats *>(ctx);
+  size_t *block = reinterpret_cast<size_t *>(
+      static_cast<char *>(ptr) - sizeof(max_align_t));
+  EXPECT_EQ(*block, size);
+  stats->num_frees++;
+  stats->bytes_live -= size;
+  free(block);
+}
+
+TEST_F(Test_HashTable, Allocator) {
+  HTKeyValue_t newkv, oldkv;
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+  opts[kIncremental].min_load_factor = 0.2;
+
+  for (int t = 0; t < kNumOptions; t++) {
+    AllocStats stats = {0, 0, 0};
+    Allocator allocator = {CountingAlloc, CountingDealloc, &stats};
+    opts[t].allocator = &allocator;
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+
+    // The record and its arrays came from the allocator.  The table only
+    // keeps a copy of the Allocator record.
+    ASSERT_EQ(t == kFlat ? 4 : 3, stats.num_allocs);
+    allocator.alloc = NULL;
+
+    // Growing, shrinking and iterating all go through the allocator.
+    for (int i = 0; i < 10000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    }
+    int num_allocs = stats.num_allocs;
+    int num_frees = stats.num_frees;
+    HTIterator_Free(HTIterator_Allocate(table));
+    ASSERT_EQ(num_allocs + 1, stats.num_allocs);
+    ASSERT_EQ(num_frees + 1, stats.num_frees);
+    for (int i = 0; i < 10000; i += 3) {
+      ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+    }
+    HashTable_Compact(table);
+    ASSERT_GT(stats.num_allocs, 10);
+
+    // Everything comes back, at the size it was allocated.
+    HashTable_Free(table, NULL);
+    ASSERT_EQ(stats.num_allocs, stats.num_frees);
+    ASSERT_EQ(0U, stats.bytes_live);
+  }
+}
+
+TEST_F(Test_HashTable, MemoryUsage) {
+  HTKeyValue_t newkv, oldkv;
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  for (int t = 0; t < kNumOptions; t++) {
+    AllocStats stats = {0, 0, 0};
+    Allocator allocator = {CountingAlloc, CountingDealloc, &stats};
+    opts[t].allocator = &allocator;
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+
+    // The total always matches what the table has allocated, through
+    // growth (and a migration, for the incremental table), removal and
+    // compaction.
+    HTMemoryUsage usage;
+    for (int i = 0; i < 10000; i++) {
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+      if (i % 997 == 0) {
+        usage = HashTable_MemoryUsage(table);
+        ASSERT_EQ(stats.bytes_live, usage.total_bytes);
+      }
+    }
+    usage = HashTable_MemoryUsage(table);
+    ASSERT_EQ(10000 * sizeof(HTKeyValue_t), usage.entry_bytes);
+    ASSERT_GT(usage.index_bytes, sizeof(HashTable));
+    ASSERT_EQ(usage.index_bytes + usage.node_bytes + usage.entry_bytes,
+              usage.total_bytes);
+    ASSERT_EQ(stats.bytes_live, usage.total_bytes);
+
+    // Removed elements' memory stays with the table until it's compacted,
+    // and then only a flat table gives it back.
+    for (int i = 0; i < 10000; i++) {
+      ASSERT_TRUE(i % 4 == 0 || HashTable_Remove(table, i, &oldkv));
+    }
+    HTMemoryUsage removed = HashTable_MemoryUsage(table);
+    ASSERT_EQ(2500 * sizeof(HTKeyValue_t), removed.entry_bytes);
+    ASSERT_EQ(usage.total_bytes, removed.total_bytes);
+    HashTable_Compact(table);
+    usage = HashTable_MemoryUsage(table);
+    ASSERT_EQ(stats.bytes_live, usage.total_bytes);
+    ASSERT_LT(usage.index_bytes, removed.index_bytes);
+
+    HashTable_Free(table, NULL);
+  }
+}
+
+// Fills a table with keys 0..999, replaces one, looks up 1500 keys (1000
+// hits, 500 misses), and removes the even keys, leaving 500.
+static void StatsWorkload(HashTable *table) {
+  HTKeyValue_t newkv, oldkv;
+
+  for (int i = 0; i < 1000; i++) {
+    newkv.key = i;
+    newkv.value = NULL;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+  ASSERT_TRUE(HashTable_Insert(table, newkv, &oldkv));
+  for (int i = 0; i < 1500; i++) {
+    ASSERT_EQ(i < 1000, HashTable_Find(table, i, &oldkv));
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+  }
+}
+
+TEST_F(Test_HashTable, StatsShape) {
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  // The shape of the table is reported even when the library is built
+  // with HT_DISABLE_STATS.
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+    ASSERT_NO_FATAL_FAILURE(StatsWorkload(table));
+    HTStats stats = HashTable_GetStats(table);
+
+    // The chain histogram covers every bucket and element.
+    if (t != kFlat) {
+      uint64_t num_buckets = 0, num_elements = 0;
+      for (int len = 0; len < HT_STATS_CHAIN_BINS; len++) {
+        num_buckets += stats.chain_histogram[len];
+        num_elements += len * stats.chain_histogram[len];
+        if (stats.chain_histogram[len] != 0) {
+          ASSERT_LE(len, stats.max_chain);
+        }
+      }
+      ASSERT_EQ(static_cast<uint64_t>(table->num_buckets), num_buckets);
+      ASSERT_EQ(500U, num_elements);
+      ASSERT_GE(stats.mean_chain, 1.0);
+      ASSERT_DOUBLE_EQ(500.0 / table->num_buckets, stats.load_factor);
+    } else {
+      ASSERT_EQ(0, stats.max_chain);
+    }
+    HashTable_Free(table, NULL);
+  }
+}
+
+#ifndef HT_DISABLE_STATS
+TEST_F(Test_HashTable, StatsCounters) {
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  for (int t = 0; t < kNumOptions; t++) {
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+    ASSERT_NO_FATAL_FAILURE(StatsWorkload(table));
+    HTStats stats = HashTable_GetStats(table);
+
+    ASSERT_EQ(1000U, stats.inserts);
+    ASSERT_EQ(1U, stats.replacements);
+    ASSERT_EQ(1500U, stats.finds);
+    ASSERT_EQ(1000U, stats.hits);
+    ASSERT_EQ(500U, stats.misses);
+    ASSERT_EQ(500U, stats.removes);
+    ASSERT_GT(stats.resizes, 0U);
+    ASSERT_GT(stats.resize_nanos, 0U);
+    ASSERT_GE(stats.keys_compared, 1501U);
+    HashTable_Free(table, NULL);
+  }
+}
+#endif  // HT_DISABLE_STATS
+
+TEST_F(Test_HashTable, Latency) {
+  // Percentiles are good to within a bucket (12.5%), and never over the
+  // largest latency recorded.
+  HTLatencyHistogram *histogram = new HTLatencyHistogram();
+  ASSERT_EQ(0U, HTLatency_Percentile(histogram, 50.0));
+  for (uint64_t ns = 1; ns <= 1000; ns++) {
+    HTLatency_Record(histogram, ns);
+  }
+  ASSERT_EQ(1000U, histogram->count);
+  ASSERT_EQ(500500U, histogram->total_ns);
+  ASSERT_EQ(1000U, histogram->max_ns);
+  ASSERT_EQ(1U, HTLatency_Percentile(histogram, 0.0));
+  ASSERT_GE(HTLatency_Percentile(histogram, 50.0), 500U);
+  ASSERT_LE(HTLatency_Percentile(histogram, 50.0), 563U);
+  ASSERT_GE(HTLatency_Percentile(histogram, 99.0), 990U);
+  ASSERT_EQ(1000U, HTLatency_Percentile(histogram, 99.9));
+  ASSERT_EQ(1000U, HTLatency_Percentile(histogram, 100.0));
+  HTLatency_Record(histogram, UINT64_MAX);
+  ASSERT_EQ(UINT64_MAX, HTLatency_Percentile(histogram, 100.0));
+
+  // Tables only record latencies when built to.
+  HashTable *table = HashTable_Allocate(2);
+  HTKeyValue_t newkv, oldkv;
+  for (int i = 0; i < 1000; i++) {
+    newkv.key = i;
+    newkv.value = NULL;
+    ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    ASSERT_TRUE(HashTable_Find(table, i, &oldkv));
+  }
+  ASSERT_TRUE(HashTable_Remove(table, 0, &oldkv));
+  bool enabled =
+      HashTable_LatencySnapshot(table, HT_LATENCY_INSERT, histogram);
+  ASSERT_EQ(enabled ? 1000U : 0U, histogram->count);
+  HashTable_LatencySnapshot(table, HT_LATENCY_FIND, histogram);
+  ASSERT_EQ(enabled ? 1000U : 0U, histogram->count);
+  HashTable_LatencySnapshot(table, HT_LATENCY_REMOVE, histogram);
+  ASSERT_EQ(enabled ? 1U : 0U, histogram->count);
+  HashTable_LatencySnapshot(table, HT_LATENCY_RESIZE, histogram);
+  ASSERT_EQ(enabled, histogram->count > 0);
+  HashTable_LatencyReset(table);
+  HashTable_LatencySnapshot(table, HT_LATENCY_INSERT, histogram);
+  ASSERT_EQ(0U, histogram->count);
+
+  HashTable_Free(table, NULL);
+  delete histogram;
+}
+
+// Values in the Trace test are sizes, so that any size can be recorded.
+static size_t ValueAsSize(HTValue_t value) {
+  return reinterpret_cast<uintptr_t>(value);
+}
+
+TEST_F(Test_HashTable, Trace) {
+  ASSERT_EQ(0, HTTrace_SizeClass(0));
+  ASSERT_EQ(1, HTTrace_SizeClass(1));
+  ASSERT_EQ(2, HTTrace_SizeClass(2));
+  ASSERT_EQ(3, HTTrace_SizeClass(3));
+  ASSERT_EQ(4, HTTrace_SizeClass(8));
+  ASSERT_EQ(5, HTTrace_SizeClass(9));
+
+  FILE *file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  HashTable *table = HashTable_Allocate(4);
+  HTKeyValue_t newkv, oldkv;
+  HTValue_t *slot;
+  bool inserted;
+
+  HashTable_StartTrace(table, file, &ValueAsSize);
+  newkv.key = 7;
+  newkv.value = reinterpret_cast<HTValue_t>(100);
+  ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  ASSERT_TRUE(HashTable_Find(table, 7, &oldkv));
+  HashTable_FindOrInsert(table, 8, &slot, &inserted);
+  ASSERT_TRUE(inserted);
+  HTIterator *it = HTIterator_Allocate(table);
+  ASSERT_TRUE(HTIterator_Remove(it, &oldkv));
+  HTKey_t removed = oldkv.key;
+  HTIterator_Free(it);
+  HashTable_Reserve(table, 50);
+  ASSERT_FALSE(HashTable_Remove(table, 9, &oldkv));
+  HashTable_Compact(table);
+  HashTable_Free(table, NULL);
+
+  const struct {
+    HTTraceOp_t op;
+    uint8_t size_class;
+    HTKey_t key;
+  } expected[] = {
+    { HT_TRACE_BEGIN, 0, 4 },
+    { HT_TRACE_INSERT, 8, 7 },
+    { HT_TRACE_FIND, 0, 7 },
+    { HT_TRACE_FIND_OR_INSERT, 0, 8 },
+    { HT_TRACE_ITERATE, 0, 0 },
+    { HT_TRACE_REMOVE, 0, removed },
+    { HT_TRACE_RESERVE, 0, 50 },
+    { HT_TRACE_REMOVE, 0, 9 },
+    { HT_TRACE_COMPACT, 0, 0 },
+    { HT_TRACE_FREE, 0, 0 },
+  };
+  HTTraceRecord record;
+  rewind(file);
+  ASSERT_TRUE(HTTrace_ReadHeader(file));
+  for (const auto &e : expected) {
+    ASSERT_TRUE(HTTrace_ReadRecord(file, &record));
+    ASSERT_EQ(e.op, record.op);
+    ASSERT_EQ(e.size_class, record.size_class);
+    ASSERT_EQ(e.key, record.key);
+  }
+  ASSERT_FALSE(HTTrace_ReadRecord(file, &record));
+
+  // A file that isn't a trace is rejected.
+  rewind(file);
+  fputs("not a trace", file);
+  rewind(file);
+  ASSERT_FALSE(HTTrace_ReadHeader(file));
+  fclose(file);
+}
+
+TEST_F(Test_HashTable, AllocationBudget) {
+  const int kNumKeys = 10000;
+  HTKeyValue_t newkv, oldkv;
+  HTOptions opts[kNumOptions];
+  StandardOptions(opts);
+
+  for (int t = 0; t < kNumOptions; t++) {
+    // Growing from 2 buckets: a resize allocates the new index (at most
+    // three arrays), and a node may need a new slab page, so no insert
+    // allocates more than 3 times.  Pages and resizes are both geometric,
+    // so all told that's a handful of allocations, not one per key.
+    HashTable *table = HashTable_AllocateWithOptions(2, &opts[t]);
+    uint64_t total = 0;
+    for (int i = 0; i < kNumKeys; i++) {
+      AllocCounter counter;
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+      ASSERT_LE(counter.allocs(), 3U);
+      total += counter.allocs();
+    }
+    ASSERT_GT(total, 0U);  // the counter really is counting
+    ASSERT_LE(total, static_cast<uint64_t>(kNumKeys / 100));
+    HashTable_Free(table, NULL);
+
+    // Once the table has room, a new key costs at most one allocation (a
+    // node page), and replacing a key costs none.
+    table = HashTable_AllocateWithOptions(2, &opts[t]);
+    HashTable_Reserve(table, kNumKeys);
+    for (int i = 0; i < kNumKeys; i++) {
+      AllocCounter counter;
+      newkv.key = i;
+      newkv.value = NULL;
+      ASSERT_FALSE(HashTable_Insert(table, newkv, &oldkv));
+      ASSERT_LE(counter.allocs(), 1U);
+    }
+    {
+      AllocCounter counter;
+      for (int i = 0; i < kNumKeys; i++) {
+        newkv.key = i;
+        ASSERT_TRUE(HashTable_Insert(table, newkv, &oldkv));
+      }
+      ASSERT_EQ(0U, counter.allocs());
+      ASSERT_EQ(0U, counter.frees());
+    }
+
+    // Lookups, hit or miss, one at a time or batched, never allocate.
+    {
+      HTKey_t keys[64];
+      HTKeyValue_t keyvalues[64];
+      bool found[64];
+      HTValue_t *slot;
+      bool inserted;
+
+      for (int i = 0; i < 64; i++) {
+        keys[i] = i * 151;
+      }
+      AllocCounter counter;
+      for (int i = 0; i < 2 * kNumKeys; i++) {
+        ASSERT_EQ(i < kNumKeys, HashTable_Find(table, i, &oldkv));
+      }
+      ASSERT_EQ(64, HashTable_FindBatch(table, keys, 64, keyvalues, found));
+      HashTable_FindOrInsert(table, 0, &slot, &inserted);
+      ASSERT_FALSE(inserted);
+      ASSERT_EQ(0U, counter.allocs());
+      ASSERT_EQ(0U, counter.frees());
+    }
+
+    // An iterator is one allocation, however far it goes.
+    {
+      AllocCounter counter;
+      HTIterator *it = HTIterator_Allocate(table);
+      int count = 0;
+      for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+        ASSERT_TRUE(HTIterator_Get(it, &oldkv));
+        count++;
+      }
+      HTIterator_Free(it);
+      ASSERT_EQ(kNumKeys, count);
+      ASSERT_EQ(1U, counter.allocs());
+      ASSERT_EQ(1U, counter.frees());
+    }
+
+    // Removing keys never allocates.
+    {
+      AllocCounter counter;
+      for (int i = 0; i < kNumKeys; i++) {
+        ASSERT_TRUE(HashTable_Remove(table, i, &oldkv));
+      }
+      ASSERT_EQ(0U, counter.allocs());
+    }
+    HashTable_Free(table, NULL);
+  }
+}
+
 }  // namespace hw1
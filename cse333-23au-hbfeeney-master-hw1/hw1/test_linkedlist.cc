@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/select.h>
+#include <string.h>
 
 #include "gtest/gtest.h"
 
@@ -20,6 +21,7 @@ extern "C" {
   #include "./LinkedList_priv.h"
 }
 
+#include "./test_alloc_counter.h"
 #include "./test_suite.h"
 
 namespace hw1 {
@@ -371,5 +373,201 @@ TEST_F(Test_LinkedList, TestLLIteratorBasic) {
   LinkedList_Free(llp, &Test_LinkedList::StubbedFree);
 }
 
+TEST_F(Test_LinkedList, FindAndStackIterator) {
+  LinkedList *llp = LinkedList_Allocate();
+  LLPayload_t payload;
+
+  // Nothing to find in an empty list, and a stack iterator on it is
+  // already past the end.
+  ASSERT_FALSE(LinkedList_Find(llp, kOne, &TestLLPayloadComparator,
+                               &payload));
+  LLIterator it;
+  memset(&it, 0xFF, sizeof(it));
+  LLIterator_Init(&it, llp);
+  ASSERT_FALSE(LLIterator_IsValid(&it));
+
+  // Every field is set, so LLIterator_Free can tell it wasn't allocated.
+  ASSERT_FALSE(it.allocated);
+  ASSERT_EQ(nullptr, it.allocator.alloc);
+
+  LinkedList_Append(llp, kOne);
+  LinkedList_Append(llp, kTwo);
+  LinkedList_Append(llp, kThree);
+  ASSERT_TRUE(LinkedList_Find(llp, kTwo, &TestLLPayloadComparator,
+                              &payload));
+  ASSERT_EQ(kTwo, payload);
+  ASSERT_TRUE(LinkedList_Find(llp, kThree, &TestLLPayloadComparator,
+                              &payload));
+  ASSERT_EQ(kThree, payload);
+  ASSERT_FALSE(LinkedList_Find(llp, kFour, &TestLLPayloadComparator,
+                               &payload));
+
+  // Walk the list with a stack iterator, removing kTwo along the way.
+  LLIterator_Init(&it, llp);
+  ASSERT_EQ(llp, it.list);
+  ASSERT_EQ(llp->head, it.node);
+  LLIterator_Get(&it, &payload);
+  ASSERT_EQ(kOne, payload);
+  ASSERT_TRUE(LLIterator_Next(&it));
+  ASSERT_TRUE(LLIterator_Remove(&it, &Test_LinkedList::StubbedFree));
+  ASSERT_EQ(1, freeInvocations_);
+  LLIterator_Get(&it, &payload);
+  ASSERT_EQ(kThree, payload);
+  ASSERT_FALSE(LLIterator_Next(&it));
+  ASSERT_EQ(2, LinkedList_NumElements(llp));
+  ASSERT_FALSE(LinkedList_Find(llp, kTwo, &TestLLPayloadComparator,
+                               &payload));
+
+  LinkedList_Free(llp, &Test_LinkedList::StubbedFree);
+  ASSERT_EQ(3, freeInvocations_);
+}
+
+// Counts the allocations made through an Allocator, for the Allocator test.
+static void* CountingAlloc(void *ctx, size_t size) {
+  (*static_cast<int *>(ctx))++;
+  return malloc(size);
+}
+
+static void CountingDealloc(void *ctx, void *ptr, size_t size) {
+  (*static_cast<int *>(ctx))--;
+  free(ptr);
+}
+
+TEST_F(Test_LinkedList, Allocator) {
+  int num_live = 0;
+  Allocator allocator = {CountingAlloc, CountingDealloc, &num_live};
+  LinkedList *llp = LinkedList_AllocateWithAllocator(&allocator);
+  ASSERT_EQ(1, num_live);
+
+  // Nodes and iterators come from the allocator too.
+  for (intptr_t i = 1; i <= 1000; i++) {
+    LinkedList_Append(llp, reinterpret_cast<LLPayload_t>(i));
+  }
+  ASSERT_GT(num_live, 1);
+  int num_list = num_live;
+  LLIterator *it = LLIterator_Allocate(llp);
+  ASSERT_EQ(num_list + 1, num_live);
+  LLIterator_Free(it);
+  ASSERT_EQ(num_list, num_live);
+
+  // An iterator can outlive its list.
+  it = LLIterator_Allocate(llp);
+  LinkedList_Free(llp, &Test_LinkedList::StubbedFree);
+  ASSERT_EQ(1, num_live);
+  LLIterator_Free(it);
+  ASSERT_EQ(0, num_live);
+}
+
+TEST_F(Test_LinkedList, MemoryUsage) {
+  LinkedList *llp = LinkedList_Allocate();
+  LLMemoryUsage usage = LinkedList_MemoryUsage(llp);
+  ASSERT_EQ(sizeof(LinkedList), usage.list_bytes);
+  ASSERT_EQ(0U, usage.node_bytes);
+  ASSERT_EQ(0U, usage.payload_bytes);
+  ASSERT_EQ(sizeof(LinkedList), usage.total_bytes);
+
+  // A short list holds pages for only the nodes it has used: one of one
+  // node, then one of two.
+  LinkedList_Push(llp, reinterpret_cast<LLPayload_t>(1));
+  usage = LinkedList_MemoryUsage(llp);
+  ASSERT_EQ(sizeof(LinkedList) + sizeof(SlabPage) + sizeof(LinkedListNode),
+            usage.total_bytes);
+  LinkedList_Push(llp, reinterpret_cast<LLPayload_t>(2));
+  LinkedList_Push(llp, reinterpret_cast<LLPayload_t>(3));
+  usage = LinkedList_MemoryUsage(llp);
+  ASSERT_EQ(sizeof(LinkedList) + 2 * sizeof(SlabPage) +
+            3 * sizeof(LinkedListNode), usage.total_bytes);
+
+  for (intptr_t i = 4; i <= 1000; i++) {
+    LinkedList_Push(llp, reinterpret_cast<LLPayload_t>(i));
+  }
+  usage = LinkedList_MemoryUsage(llp);
+  ASSERT_EQ(1000 * sizeof(LLPayload_t), usage.payload_bytes);
+  ASSERT_GE(usage.node_bytes, 1000 * 2 * sizeof(LinkedListNode *));
+  ASSERT_EQ(usage.list_bytes + usage.node_bytes + usage.payload_bytes,
+            usage.total_bytes);
+
+  // Popped nodes are kept for reuse, so the total doesn't drop.
+  LLPayload_t payload;
+  ASSERT_TRUE(LinkedList_Pop(llp, &payload));
+  LLMemoryUsage popped = LinkedList_MemoryUsage(llp);
+  ASSERT_EQ(999 * sizeof(LLPayload_t), popped.payload_bytes);
+  ASSERT_EQ(usage.total_bytes, popped.total_bytes);
+
+  LinkedList_Free(llp, &Test_LinkedList::StubbedFree);
+}
+
+TEST_F(Test_LinkedList, AllocationBudget) {
+  const int kNumPayloads = 1000;
+  LinkedList *llp;
+  LLPayload_t payload;
+
+  {
+    AllocCounter counter;
+    llp = LinkedList_Allocate();
+    ASSERT_EQ(1U, counter.allocs());
+  }
+
+  // Nodes come from the list's slab, so a push or append allocates at
+  // most once (for a new page), and pages grow geometrically, so most
+  // allocate nothing.  A pop hands its node back to the slab.
+  uint64_t total = 0;
+  for (int i = 1; i <= kNumPayloads; i++) {
+    AllocCounter counter;
+    LinkedList_Push(llp, reinterpret_cast<LLPayload_t>(i));
+    ASSERT_LE(counter.allocs(), 1U);
+    total += counter.allocs();
+  }
+  for (int i = 1; i <= kNumPayloads; i++) {
+    AllocCounter counter;
+    LinkedList_Append(llp, reinterpret_cast<LLPayload_t>(i));
+    ASSERT_LE(counter.allocs(), 1U);
+    total += counter.allocs();
+  }
+  ASSERT_GT(total, 0U);  // the counter really is counting
+  ASSERT_LE(total, static_cast<uint64_t>(2 * kNumPayloads / 100));
+  {
+    AllocCounter counter;
+    ASSERT_TRUE(LinkedList_Pop(llp, &payload));
+    LinkedList_Push(llp, payload);
+    ASSERT_EQ(0U, counter.allocs());
+    ASSERT_EQ(0U, counter.frees());
+  }
+
+  // Finding, sorting and walking the list with a stack iterator never
+  // allocate.
+  {
+    AllocCounter counter;
+    ASSERT_TRUE(LinkedList_Find(llp, reinterpret_cast<LLPayload_t>(500),
+                                &TestLLPayloadComparator, &payload));
+    ASSERT_FALSE(LinkedList_Find(
+        llp, reinterpret_cast<LLPayload_t>(kNumPayloads + 1),
+        &TestLLPayloadComparator, &payload));
+    LinkedList_Sort(llp, true, &TestLLPayloadComparator);
+    LLIterator it;
+    int count = 0;
+    for (LLIterator_Init(&it, llp); LLIterator_IsValid(&it);
+         LLIterator_Next(&it)) {
+      LLIterator_Get(&it, &payload);
+      count++;
+    }
+    ASSERT_EQ(2 * kNumPayloads, count);
+    ASSERT_EQ(0U, counter.allocs());
+    ASSERT_EQ(0U, counter.frees());
+  }
+
+  // A heap iterator is one allocation, however far it goes.
+  {
+    AllocCounter counter;
+    LLIterator *it = LLIterator_Allocate(llp);
+    while (LLIterator_Next(it)) { }
+    LLIterator_Free(it);
+    ASSERT_EQ(1U, counter.allocs());
+    ASSERT_EQ(1U, counter.frees());
+  }
+
+  LinkedList_Free(llp, &Test_LinkedList::StubbedFree);
+}
+
 }  // namespace hw1
 
@@ -0,0 +1,106 @@
+/*
+ * Copyright ©2023 Chris Thachuk.  All rights reserved.  Permission is
+ * hereby granted to students registered for University of Washington
+ * CSE 333 for use solely during Fall Quarter 2023 for purposes of
+ * the course.  No other use, copying, distribution, or modification
+ * is permitted without prior written consent. Copyrights for
+ * third-party components of this work must be honored.  Instructors
+ * interested in reusing these course materials should contact the
+ * author.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+  #include "./Slab.h"
+}
+
+#include "./test_suite.h"
+
+namespace hw1 {
+
+// Returns the number of pages in slab.
+static int NumPages(const Slab *slab) {
+  int n = 0;
+  for (SlabPage *page = slab->pages; page != NULL; page = page->next) {
+    n++;
+  }
+  return n;
+}
+
+TEST(Test_Slab, AllocFree) {
+  Slab slab;
+  Slab_Init(&slab, 20, NULL);
+  ASSERT_EQ(24U, slab.object_size);
+  ASSERT_EQ(nullptr, slab.pages);
+
+  // Objects are distinct, pointer-aligned, writable, and come out of each
+  // page back to back.  Pages hold 1, 2, 4, 8... objects, so the fourth
+  // holds objects 7 through 14.
+  const int kNumObjects = 5000;
+  static char *objects[kNumObjects];
+  for (int i = 0; i < kNumObjects; i++) {
+    objects[i] = static_cast<char *>(Slab_Alloc(&slab));
+    ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(objects[i]) % sizeof(void *));
+    memset(objects[i], i & 0xFF, 20);
+    if (i > 7 && i < 15) {
+      ASSERT_EQ(objects[i - 1] + 24, objects[i]);
+    }
+  }
+  for (int i = 0; i < kNumObjects; i++) {
+    ASSERT_EQ(static_cast<char>(i & 0xFF), objects[i][19]);
+  }
+  int num_pages = NumPages(&slab);
+  ASSERT_LT(num_pages, 20);
+
+  // Freed objects are reused, most recent first, without new pages.
+  Slab_Free(&slab, objects[10]);
+  Slab_Free(&slab, objects[20]);
+  ASSERT_EQ(objects[20], Slab_Alloc(&slab));
+  ASSERT_EQ(objects[10], Slab_Alloc(&slab));
+  for (int i = 0; i < kNumObjects; i++) {
+    Slab_Free(&slab, objects[i]);
+  }
+  for (int i = 0; i < kNumObjects; i++) {
+    Slab_Alloc(&slab);
+  }
+  ASSERT_EQ(num_pages, NumPages(&slab));
+
+  // Releasing leaves an empty slab that can be used again.
+  Slab_Release(&slab);
+  ASSERT_EQ(nullptr, slab.pages);
+  ASSERT_EQ(24U, slab.object_size);
+  ASSERT_NE(nullptr, Slab_Alloc(&slab));
+  Slab_Release(&slab);
+}
+
+TEST(Test_Slab, Reserve) {
+  Slab slab;
+  Slab_Init(&slab, sizeof(void *), NULL);
+
+  // Reserving on top of objects already free adds one page covering just
+  // the shortfall, and nothing more is allocated until the reservation is
+  // used up.
+  void *first = Slab_Alloc(&slab);
+  Slab_Free(&slab, first);
+  Slab_Reserve(&slab, 1000);
+  ASSERT_EQ(2, NumPages(&slab));
+  ASSERT_EQ(1000U - 1, slab.pages->capacity);
+  for (int i = 0; i < 1000; i++) {
+    Slab_Alloc(&slab);
+  }
+  ASSERT_EQ(2, NumPages(&slab));
+  Slab_Alloc(&slab);
+  ASSERT_EQ(3, NumPages(&slab));
+
+  // A reservation that's already covered does nothing.
+  Slab_Reserve(&slab, 1);
+  Slab_Reserve(&slab, 0);
+  ASSERT_EQ(3, NumPages(&slab));
+  Slab_Release(&slab);
+}
+
+}  // namespace hw1